@@ -0,0 +1,282 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include "aio.h"
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+
+using namespace std;
+
+
+namespace number {
+
+
+async_io::~async_io()
+{
+	if (d_sqes)
+		munmap(d_sqes, d_sqes_len);
+	if (d_rings)
+		munmap(d_rings, d_ring_len);
+	if (d_ring >= 0)
+		close(d_ring);
+	if (d_epoll >= 0)
+		close(d_epoll);
+}
+
+
+int async_io::init(unsigned int depth, bool uring)
+{
+	if (depth == 0 || d_depth > 0)
+		return -1;
+
+	d_depth = depth;
+	d_ops.resize(depth);
+	for (unsigned int i = depth; i > 0; --i)
+		d_free.push_back(i - 1);
+
+	if (uring && init_uring() == 0)
+		return 0;
+
+	if ((d_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		return -1;
+	return 0;
+}
+
+
+#ifdef HAVE_IO_URING
+
+template<typename T>
+static inline T *ring_ptr(void *base, uint32_t off)
+{
+	return reinterpret_cast<T *>(static_cast<char *>(base) + off);
+}
+
+
+int async_io::init_uring()
+{
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	if ((d_ring = syscall(__NR_io_uring_setup, d_depth, &p)) < 0) {
+		d_ring = -1;
+		return -1;
+	}
+
+	// IORING_OP_READ/WRITE came with 5.6, FAST_POLL with 5.7
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_FAST_POLL)) {
+		close(d_ring);
+		d_ring = -1;
+		return -1;
+	}
+
+	size_t sq_len = p.sq_off.array + p.sq_entries*sizeof(uint32_t);
+	size_t cq_len = p.cq_off.cqes + p.cq_entries*sizeof(io_uring_cqe);
+	d_ring_len = sq_len > cq_len ? sq_len : cq_len;
+	d_sqes_len = p.sq_entries*sizeof(io_uring_sqe);
+
+	d_rings = mmap(nullptr, d_ring_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, d_ring, IORING_OFF_SQ_RING);
+	if (d_rings == MAP_FAILED) {
+		d_rings = nullptr;
+		close(d_ring);
+		d_ring = -1;
+		return -1;
+	}
+	d_sqes = mmap(nullptr, d_sqes_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, d_ring, IORING_OFF_SQES);
+	if (d_sqes == MAP_FAILED) {
+		d_sqes = nullptr;
+		munmap(d_rings, d_ring_len);
+		d_rings = nullptr;
+		close(d_ring);
+		d_ring = -1;
+		return -1;
+	}
+
+	d_sq_tail = ring_ptr<uint32_t>(d_rings, p.sq_off.tail);
+	d_sq_array = ring_ptr<uint32_t>(d_rings, p.sq_off.array);
+	d_sq_mask = *ring_ptr<uint32_t>(d_rings, p.sq_off.ring_mask);
+	d_cq_head = ring_ptr<uint32_t>(d_rings, p.cq_off.head);
+	d_cq_tail = ring_ptr<uint32_t>(d_rings, p.cq_off.tail);
+	d_cq_mask = *ring_ptr<uint32_t>(d_rings, p.cq_off.ring_mask);
+	d_cqes = ring_ptr<io_uring_cqe>(d_rings, p.cq_off.cqes);
+
+	return 0;
+}
+
+
+int async_io::complete_uring(aio_op *done, int max, bool block)
+{
+	uint32_t head = *d_cq_head;
+	bool ready = (head != __atomic_load_n(d_cq_tail, __ATOMIC_ACQUIRE));
+
+	if (d_unsubmitted > 0 || (block && !ready && d_busy > 0)) {
+		unsigned int wait = (block && !ready && d_busy > 0) ? 1 : 0;
+		int r = 0;
+		while ((r = syscall(__NR_io_uring_enter, d_ring, d_unsubmitted, wait, IORING_ENTER_GETEVENTS, nullptr, 0)) < 0 && errno == EINTR);
+		if (r < 0)
+			return -1;
+		d_unsubmitted -= r;
+	}
+
+	int n = 0;
+	io_uring_cqe *cqes = static_cast<io_uring_cqe *>(d_cqes);
+	for (; n < max && head != __atomic_load_n(d_cq_tail, __ATOMIC_ACQUIRE); ++head, ++n) {
+		io_uring_cqe &cqe = cqes[head & d_cq_mask];
+		aio_op &op = d_ops[cqe.user_data];
+		op.res = cqe.res;
+		done[n] = op;
+		d_free.push_back(cqe.user_data);
+		--d_busy;
+	}
+	__atomic_store_n(d_cq_head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+#else
+
+int async_io::init_uring()
+{
+	return -1;
+}
+
+
+int async_io::complete_uring(aio_op *, int, bool)
+{
+	return -1;
+}
+
+#endif
+
+
+int async_io::queue(const aio_op &op)
+{
+	if (d_free.empty())
+		return -1;
+
+	unsigned int slot = d_free.back();
+	d_free.pop_back();
+	d_ops[slot] = op;
+	++d_busy;
+
+#ifdef HAVE_IO_URING
+	if (d_ring >= 0) {
+		uint32_t tail = *d_sq_tail, idx = tail & d_sq_mask;
+		io_uring_sqe &sqe = static_cast<io_uring_sqe *>(d_sqes)[idx];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = op.write ? IORING_OP_WRITE : IORING_OP_READ;
+		sqe.fd = op.fd;
+		sqe.addr = reinterpret_cast<uint64_t>(op.buf);
+		sqe.len = op.len;
+		sqe.off = op.off < 0 ? uint64_t(-1) : uint64_t(op.off);
+		sqe.user_data = slot;
+		d_sq_array[idx] = idx;
+		__atomic_store_n(d_sq_tail, tail + 1, __ATOMIC_RELEASE);
+		++d_unsubmitted;
+		return 0;
+	}
+#endif
+
+	d_pending.push_back(slot);
+	return 0;
+}
+
+
+// pread()/pwrite() for files, epoll for the rest, in queueing order
+int async_io::complete_sync(aio_op *done, int max, bool block)
+{
+	int n = 0;
+	epoll_event ev;
+
+	while (n < max && !d_pending.empty()) {
+		unsigned int slot = d_pending.front();
+		aio_op &op = d_ops[slot];
+
+		if (op.off < 0) {
+			if (d_polled.count(op.fd) == 0) {
+				memset(&ev, 0, sizeof(ev));
+				ev.data.fd = op.fd;
+				// EPERM: regular file, which is always ready
+				if (epoll_ctl(d_epoll, EPOLL_CTL_ADD, op.fd, &ev) < 0 && errno != EPERM)
+					return -1;
+				d_polled.insert(op.fd);
+			}
+
+			memset(&ev, 0, sizeof(ev));
+			ev.events = op.write ? EPOLLOUT : EPOLLIN;
+			ev.data.fd = op.fd;
+			if (epoll_ctl(d_epoll, EPOLL_CTL_MOD, op.fd, &ev) == 0) {
+				int r = 0;
+				while ((r = epoll_wait(d_epoll, &ev, 1, (block && n == 0) ? -1 : 0)) < 0 && errno == EINTR);
+
+				// only the fd at the front may ever be reported
+				memset(&ev, 0, sizeof(ev));
+				ev.data.fd = op.fd;
+				epoll_ctl(d_epoll, EPOLL_CTL_MOD, op.fd, &ev);
+
+				if (r < 0)
+					return -1;
+				if (r == 0)
+					break;
+			}
+			op.res = op.write ? write(op.fd, op.buf, op.len) : read(op.fd, op.buf, op.len);
+		} else
+			op.res = op.write ? pwrite(op.fd, op.buf, op.len, op.off) : pread(op.fd, op.buf, op.len, op.off);
+
+		if (op.res < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			op.res = -errno;
+		}
+
+		done[n++] = op;
+		d_pending.erase(d_pending.begin());
+		d_free.push_back(slot);
+		--d_busy;
+	}
+
+	return n;
+}
+
+
+int async_io::complete(aio_op *done, int max, bool block)
+{
+	if (d_ring >= 0)
+		return complete_uring(done, max, block);
+	return complete_sync(done, max, block);
+}
+
+
+}
+
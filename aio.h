@@ -0,0 +1,118 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_aio_h
+#define number_aio_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+#include <set>
+
+
+namespace number {
+
+
+struct aio_op {
+	int fd{-1};
+	char *buf{nullptr};
+	size_t len{0};
+	int64_t off{-1};	// < 0: at the current file position, e.g. for pipes
+	bool write{0};
+	uint64_t tag{0};
+	ssize_t res{0};		// bytes transferred or -errno
+};
+
+
+// Queue of reads and writes that are kept in flight together. Uses io_uring
+// where the kernel has it, otherwise pread()/pwrite() and, for pipes and
+// sockets, epoll to only touch fds that are ready.
+class async_io {
+
+	unsigned int d_depth{0};
+
+	std::vector<aio_op> d_ops;
+	std::vector<unsigned int> d_free;
+
+	// submitted or queued ops
+	size_t d_busy{0};
+
+	// io_uring
+	int d_ring{-1};
+	size_t d_ring_len{0}, d_sqes_len{0};
+	void *d_rings{nullptr}, *d_sqes{nullptr}, *d_cqes{nullptr};
+	unsigned int *d_sq_tail{nullptr}, *d_sq_array{nullptr}, *d_cq_head{nullptr}, *d_cq_tail{nullptr};
+	unsigned int d_sq_mask{0}, d_cq_mask{0}, d_unsubmitted{0};
+
+	// fallback
+	int d_epoll{-1};
+	std::set<int> d_polled;
+	std::vector<unsigned int> d_pending;
+
+	int init_uring();
+
+	int complete_uring(aio_op *, int, bool);
+
+	int complete_sync(aio_op *, int, bool);
+
+public:
+
+	async_io()
+	{
+	}
+
+	~async_io();
+
+	async_io(const async_io &) = delete;
+
+	async_io &operator=(const async_io &) = delete;
+
+	// up to depth ops in flight; uring == 0 forces the fallback
+	int init(unsigned int depth, bool uring = 1);
+
+	// -1 if depth ops are in flight already
+	int queue(const aio_op &);
+
+	// Start queued ops and collect up to max finished ones. With block set,
+	// waits until at least one finished if anything is in flight.
+	int complete(aio_op *done, int max, bool block);
+
+	size_t busy() const
+	{
+		return d_busy;
+	}
+
+	bool full() const
+	{
+		return d_free.empty();
+	}
+
+	const char *backend() const
+	{
+		return d_ring >= 0 ? "io_uring" : "epoll/pread";
+	}
+};
+
+
+}
+
+#endif
+
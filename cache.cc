@@ -0,0 +1,212 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <mutex>
+#include "base64.h"
+#include "digest.h"
+#include "misc.h"
+#include "cache.h"
+
+
+namespace number {
+
+using namespace std;
+
+
+result_cache::result_cache(size_t max)
+{
+	if (max == 0)
+		max = 1;
+	d_slots.resize(max);
+	d_index.reserve(max);
+}
+
+
+size_t result_cache::victim()
+{
+	for (;;) {
+		size_t i = d_hand;
+		d_hand = (d_hand + 1) % d_slots.size();
+
+		if (!d_slots[i].used)
+			return i;
+		if (!d_slots[i].ref)
+			return i;
+		d_slots[i].ref = 0;
+	}
+}
+
+
+bool result_cache::find(const string &key, results_t &r)
+{
+	lock_guard<mutex> g(d_lock);
+
+	auto it = d_index.find(digest64(key));
+	if (it == d_index.end() || d_slots[it->second].key != key) {
+		++d_misses;
+		return 0;
+	}
+
+	slot &s = d_slots[it->second];
+	s.ref = 1;
+	r = s.results;
+	++d_hits;
+	return 1;
+}
+
+
+void result_cache::insert(const string &key, const results_t &r)
+{
+	lock_guard<mutex> g(d_lock);
+
+	uint64_t h = digest64(key);
+	size_t i = 0;
+
+	auto it = d_index.find(h);
+	if (it != d_index.end()) {
+		i = it->second;
+
+		// digest collision: the newer number takes over the slot
+		if (d_slots[i].key != key) {
+			d_slots[i].key = key;
+			d_slots[i].results.clear();
+			++d_evictions;
+		}
+	} else {
+		i = victim();
+		if (d_slots[i].used) {
+			d_index.erase(digest64(d_slots[i].key));
+			d_slots[i].results.clear();
+			++d_evictions;
+		}
+		d_slots[i].key = key;
+		d_slots[i].used = 1;
+		d_index[h] = i;
+	}
+
+	for (auto j = r.begin(); j != r.end(); ++j)
+		d_slots[i].results[j->first] = j->second;
+	d_slots[i].ref = 1;
+}
+
+
+// One entry per line: b64(key) followed by name:b64(output) pairs, space separated.
+static const char *cache_magic = "# number result cache v2";
+
+
+int result_cache::load(const string &path, uint64_t fingerprint)
+{
+	free_ptr<FILE> f(fopen(path.c_str(), "r"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	char hdr[128];
+	unsigned long long fp = 0;
+	if (!fgets(hdr, sizeof(hdr), f.get()) || strncmp(hdr, cache_magic, strlen(cache_magic)) != 0 ||
+	    sscanf(hdr + strlen(cache_magic), " %llx", &fp) != 1 || fp != fingerprint)
+		return -1;
+
+	char *buf = nullptr;
+	size_t blen = 0;
+	ssize_t r = 0;
+	string line = "", tok = "", key = "", name = "", out = "";
+	string::size_type idx = 0;
+	results_t res;
+
+	while ((r = getline(&buf, &blen, f.get())) > 0) {
+		if (buf[0] == '#')
+			continue;
+		line = string(buf, r);
+		if (line[line.size() - 1] == '\n')
+			line.erase(line.size() - 1);
+
+		if ((idx = line.find(" ")) == string::npos)
+			continue;
+		key = "";
+		b64_decode(line.substr(0, idx), key);
+		line.erase(0, idx + 1);
+		if (key.size() == 0)
+			continue;
+
+		res.clear();
+		while (line.size() > 0) {
+			if ((idx = line.find(" ")) == string::npos)
+				idx = line.size();
+			tok = line.substr(0, idx);
+			line.erase(0, idx + 1);
+
+			if ((idx = tok.find(":")) == string::npos)
+				continue;
+			name = tok.substr(0, idx);
+			out = "";
+			b64_decode(tok.substr(idx + 1), out);
+			res[name] = out;
+		}
+		insert(key, res);
+	}
+
+	free(buf);
+
+	// loading must not count towards the run's statistics
+	d_evictions = 0;
+	return 0;
+}
+
+
+int result_cache::save(const string &path, uint64_t fingerprint)
+{
+	string tmp = path + ".tmp";
+	free_ptr<FILE> f(fopen(tmp.c_str(), "w"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	fprintf(f.get(), "%s %016llx\n", cache_magic, (unsigned long long)fingerprint);
+
+	string b64 = "";
+	for (auto i = d_slots.begin(); i != d_slots.end(); ++i) {
+		if (!i->used)
+			continue;
+		b64 = "";
+		fprintf(f.get(), "%s", b64_encode(i->key, b64).c_str());
+		for (auto j = i->results.begin(); j != i->results.end(); ++j) {
+			b64 = "";
+			fprintf(f.get(), " %s:%s", j->first.c_str(), b64_encode(j->second, b64).c_str());
+		}
+		fprintf(f.get(), "\n");
+	}
+
+	if (fflush(f.get()) != 0)
+		return -1;
+	f.reset();
+
+	if (rename(tmp.c_str(), path.c_str()) < 0)
+		return -1;
+	return 0;
+}
+
+
+}
+
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_cache_h
+#define number_cache_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+
+namespace number {
+
+
+// filter name -> filter output
+typedef std::map<std::string, std::string> results_t;
+
+
+// bounded result cache with CLOCK replacement, keyed by a sign byte
+// and the canonical big-endian bytes of a number
+class result_cache {
+
+	struct slot {
+		std::string key{""};
+		results_t results;
+		bool ref{0}, used{0};
+	};
+
+	std::vector<slot> d_slots;
+	std::unordered_map<uint64_t, size_t> d_index;
+	size_t d_hand{0};
+
+	// find() and insert() may be called from batch workers
+	std::mutex d_lock;
+
+	uint64_t d_hits{0}, d_misses{0}, d_evictions{0};
+
+	size_t victim();
+
+public:
+
+	explicit result_cache(size_t max);
+
+	~result_cache()
+	{
+	}
+
+	// copies cached results for key into r, returns true on hit
+	bool find(const std::string &key, results_t &r);
+
+	// merges r into the entry for key, evicting another entry if needed
+	void insert(const std::string &key, const results_t &r);
+
+	// The file header carries the format version and a fingerprint of
+	// the filter set and tables the results were computed with; a file
+	// with another version or fingerprint is not loaded.
+	int load(const std::string &, uint64_t fingerprint);
+
+	int save(const std::string &, uint64_t fingerprint);
+
+	size_t size()
+	{
+		return d_index.size();
+	}
+
+	uint64_t hits()
+	{
+		return d_hits;
+	}
+
+	uint64_t misses()
+	{
+		return d_misses;
+	}
+
+	uint64_t evictions()
+	{
+		return d_evictions;
+	}
+};
+
+
+}
+
+#endif
+
@@ -0,0 +1,331 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "digest.h"
+#include "misc.h"
+#include "catalog.h"
+
+extern "C" {
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/dh.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+}
+
+
+namespace number {
+
+using namespace std;
+
+
+int catalog::add(const BIGNUM *bn, const string &label, uint8_t kind)
+{
+	if (!bn)
+		return -1;
+	if (BN_num_bytes(bn) < MIN_LEN)
+		return 0;
+
+	entry e;
+	e.bin.resize(BN_num_bytes(bn));
+	BN_bn2bin(bn, reinterpret_cast<unsigned char *>(&e.bin[0]));
+	e.label = label;
+	e.kind = kind;
+	d_entries.push_back(e);
+	return 0;
+}
+
+
+int catalog::add(const string &hex, const string &label, uint8_t kind)
+{
+	BIGNUM *bn = nullptr;
+	if (BN_hex2bn(&bn, hex.c_str()) == 0)
+		return -1;
+	free_ptr<BIGNUM> bnp(bn, BN_free);
+	return add(bn, label, kind);
+}
+
+
+int catalog::load(const string &path, uint8_t dk)
+{
+	free_ptr<FILE> f(fopen(path.c_str(), "r"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	char buf[8192] = {0};
+	string line = "", hex = "", label = "", kind = "";
+	string::size_type idx = 0;
+	uint8_t k = 0;
+
+	for (;!feof(f.get());) {
+		memset(buf, 0, sizeof(buf));
+		if (!fgets(buf, sizeof(buf) - 1, f.get()))
+			break;
+		if (buf[0] == '#')
+			continue;
+		line = buf;
+		if ((idx = line.find(",")) == string::npos)
+			continue;
+		hex = line.substr(0, idx);
+		line.erase(0, idx + 1);
+		if ((idx = line.find(",")) == string::npos)
+			continue;
+		label = line.substr(0, idx);
+		line.erase(0, idx + 1);
+		if ((idx = line.find(",")) != string::npos)
+			kind = line.substr(0, idx);
+		else
+			kind = "";
+
+		if (kind == "")
+			k = dk;
+		else if (kind == "ec")
+			k = KIND_EC;
+		else if (kind == "hash")
+			k = KIND_HASH;
+		else if (kind == "dh")
+			k = KIND_DH;
+		else
+			k = KIND_MISC;
+
+		add(hex, label, k);
+	}
+
+	return 0;
+}
+
+
+int catalog::add_builtin(BN_CTX *ctx)
+{
+	size_t n = EC_get_builtin_curves(nullptr, 0);
+	vector<EC_builtin_curve> curves(n);
+	EC_get_builtin_curves(curves.data(), n);
+
+	free_ptr<BIGNUM> p(BN_new(), BN_free), a(BN_new(), BN_free), b(BN_new(), BN_free);
+	free_ptr<BIGNUM> x(BN_new(), BN_free), y(BN_new(), BN_free);
+	free_ptr<EC_GROUP> ecg(nullptr, EC_GROUP_free);
+	if (!p.get() || !a.get() || !b.get() || !x.get() || !y.get())
+		return -1;
+
+	for (size_t i = 0; i < n; ++i) {
+		const char *sn = OBJ_nid2sn(curves[i].nid);
+		if (!sn)
+			continue;
+		string name = sn;
+
+		ecg.reset(EC_GROUP_new_by_curve_name(curves[i].nid));
+		if (!ecg.get())
+			continue;
+		// covers GFp and GF2m curves alike, the _GFp/_GF2m variants are deprecated
+		if (EC_GROUP_get_curve(ecg.get(), p.get(), a.get(), b.get(), ctx) == 1) {
+			add(p.get(), name + " prime", KIND_EC);
+			add(a.get(), name + " a", KIND_EC);
+			add(b.get(), name + " b", KIND_EC);
+		}
+		add(EC_GROUP_get0_order(ecg.get()), name + " order", KIND_EC);
+
+		const EC_POINT *g = EC_GROUP_get0_generator(ecg.get());
+		if (g && EC_POINT_get_affine_coordinates(ecg.get(), g, x.get(), y.get(), ctx) == 1) {
+			add(x.get(), name + " generator x", KIND_EC);
+			add(y.get(), name + " generator y", KIND_EC);
+		}
+	}
+
+	free_ptr<BIGNUM> q(BN_new(), BN_free);
+	if (!q.get())
+		return -1;
+
+	// DH groups and their subgroup order q = (p - 1)/2
+	auto add_dh = [&](const BIGNUM *dhp, const string &name) {
+		if (!dhp)
+			return;
+		add(dhp, name + " prime", KIND_DH);
+		if (BN_rshift1(q.get(), dhp) == 1)
+			add(q.get(), name + " q", KIND_DH);
+	};
+
+#ifndef HAVE_LIBRESSL
+	static const struct {
+		const char *name;
+		BIGNUM *(*get)(BIGNUM *);
+	} rfc_primes[] = {
+		{"RFC2409 768bit MODP group 1", BN_get_rfc2409_prime_768},
+		{"RFC2409 1024bit MODP group 2", BN_get_rfc2409_prime_1024},
+		{"RFC3526 1536bit MODP group 5", BN_get_rfc3526_prime_1536},
+		{"RFC3526 2048bit MODP group 14", BN_get_rfc3526_prime_2048},
+		{"RFC3526 3072bit MODP group 15", BN_get_rfc3526_prime_3072},
+		{"RFC3526 4096bit MODP group 16", BN_get_rfc3526_prime_4096},
+		{"RFC3526 6144bit MODP group 17", BN_get_rfc3526_prime_6144},
+		{"RFC3526 8192bit MODP group 18", BN_get_rfc3526_prime_8192}
+	};
+
+	for (size_t i = 0; i < sizeof(rfc_primes)/sizeof(rfc_primes[0]); ++i) {
+		free_ptr<BIGNUM> dhp(rfc_primes[i].get(nullptr), BN_free);
+		add_dh(dhp.get(), rfc_primes[i].name);
+	}
+#endif
+
+#ifdef NID_ffdhe2048
+	static const struct {
+		const char *name;
+		int nid;
+	} ffdhe[] = {
+		{"RFC7919 ffdhe2048", NID_ffdhe2048},
+		{"RFC7919 ffdhe3072", NID_ffdhe3072},
+		{"RFC7919 ffdhe4096", NID_ffdhe4096},
+		{"RFC7919 ffdhe6144", NID_ffdhe6144},
+		{"RFC7919 ffdhe8192", NID_ffdhe8192}
+	};
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	// the DH_* getters are deprecated, ask the provider for the named group
+	free_ptr<EVP_PKEY_CTX> pctx(EVP_PKEY_CTX_new_from_name(nullptr, "DH", nullptr), EVP_PKEY_CTX_free);
+	if (!pctx.get())
+		return -1;
+
+	for (size_t i = 0; i < sizeof(ffdhe)/sizeof(ffdhe[0]); ++i) {
+		OSSL_PARAM params[] = {
+			OSSL_PARAM_construct_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, const_cast<char *>(OBJ_nid2sn(ffdhe[i].nid)), 0),
+			OSSL_PARAM_construct_end()
+		};
+		EVP_PKEY *pkey = nullptr;
+		if (EVP_PKEY_fromdata_init(pctx.get()) != 1 ||
+		    EVP_PKEY_fromdata(pctx.get(), &pkey, EVP_PKEY_KEY_PARAMETERS, params) != 1)
+			continue;
+		free_ptr<EVP_PKEY> pk(pkey, EVP_PKEY_free);
+		BIGNUM *dhp = nullptr;
+		if (EVP_PKEY_get_bn_param(pk.get(), OSSL_PKEY_PARAM_FFC_P, &dhp) != 1)
+			continue;
+		free_ptr<BIGNUM> dhpp(dhp, BN_free);
+		add_dh(dhp, ffdhe[i].name);
+	}
+#else
+	for (size_t i = 0; i < sizeof(ffdhe)/sizeof(ffdhe[0]); ++i) {
+		free_ptr<DH> dh(DH_new_by_nid(ffdhe[i].nid), DH_free);
+		if (dh.get())
+			add_dh(DH_get0_p(dh.get()), ffdhe[i].name);
+	}
+#endif
+#endif
+
+	return 0;
+}
+
+
+void catalog::build()
+{
+	sort(d_entries.begin(), d_entries.end(), [](const entry &e1, const entry &e2) {
+		if (e1.bin != e2.bin)
+			return e1.bin < e2.bin;
+		return e1.label < e2.label;
+	});
+
+	// drop duplicate labels for the same value
+	d_entries.erase(unique(d_entries.begin(), d_entries.end(), [](const entry &e1, const entry &e2) {
+		return e1.bin == e2.bin && e1.label == e2.label;
+	}), d_entries.end());
+
+	size_t slots = 16;
+	while (slots < 2*d_entries.size())
+		slots <<= 1;
+	d_keys.assign(slots, 0);
+	d_first.assign(slots, 0);
+	d_mask = slots - 1;
+
+	for (size_t i = 0; i < d_entries.size(); ++i) {
+		if (i > 0 && d_entries[i].bin == d_entries[i - 1].bin)
+			continue;
+		uint64_t h = digest64(d_entries[i].bin);
+		uint64_t s = h & d_mask;
+		while (d_first[s] != 0)
+			s = (s + 1) & d_mask;
+		d_keys[s] = h;
+		d_first[s] = i + 1;
+	}
+}
+
+
+void catalog::find(probe *p, size_t n) const
+{
+	uint64_t h[8];
+
+	for (size_t i = 0; i < n; i += 8) {
+		size_t m = min(n - i, size_t(8));
+
+		for (size_t j = 0; j < m; ++j) {
+			p[i + j].first = nullptr;
+			p[i + j].n = 0;
+			h[j] = digest64(p[i + j].bin, p[i + j].len);
+			if (d_first.size() > 0)
+				__builtin_prefetch(&d_first[h[j] & d_mask]);
+		}
+
+		for (size_t j = 0; j < m && d_first.size() > 0; ++j) {
+			for (uint64_t s = h[j] & d_mask; d_first[s] != 0; s = (s + 1) & d_mask) {
+				if (d_keys[s] != h[j])
+					continue;
+				const entry *e = &d_entries[d_first[s] - 1];
+				if (e->bin.size() != p[i + j].len || memcmp(e->bin.data(), p[i + j].bin, p[i + j].len) != 0)
+					continue;
+				p[i + j].first = e;
+				for (size_t k = d_first[s] - 1; k < d_entries.size() && d_entries[k].bin == e->bin; ++k)
+					++p[i + j].n;
+				break;
+			}
+		}
+	}
+}
+
+
+const catalog::entry *catalog::find(const unsigned char *bin, size_t len, size_t &n) const
+{
+	n = 0;
+	if (d_first.size() == 0)
+		return nullptr;
+
+	uint64_t h = digest64(bin, len);
+	for (uint64_t s = h & d_mask; d_first[s] != 0; s = (s + 1) & d_mask) {
+		if (d_keys[s] != h)
+			continue;
+		const entry *e = &d_entries[d_first[s] - 1];
+		if (e->bin.size() != len || memcmp(e->bin.data(), bin, len) != 0)
+			continue;
+		for (size_t i = d_first[s] - 1; i < d_entries.size() && d_entries[i].bin == e->bin; ++i)
+			++n;
+		return e;
+	}
+
+	return nullptr;
+}
+
+
+}
+
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_catalog_h
+#define number_catalog_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <openssl/bn.h>
+}
+
+
+namespace number {
+
+
+// Named well-known constants (curve parameters, DH groups, hash IVs ...)
+// in a hashed table, so that any number of them costs one probe per lookup.
+class catalog {
+
+public:
+
+	enum kind_t : uint8_t {
+		KIND_EC		= 1,
+		KIND_HASH	= 2,
+		KIND_DH		= 4,
+		KIND_MISC	= 8,
+		KIND_DB		= 16	// match DB
+	};
+
+	// shorter values are too common to name, same as the scanner's prefix
+	enum { MIN_LEN = 4 };
+
+	struct entry {
+		std::string bin{""};	// big endian, no leading zeros
+		std::string label{""};
+		uint8_t kind{0};
+	};
+
+private:
+
+	// sorted by value after build(), so that equal values are adjacent
+	std::vector<entry> d_entries;
+
+	// open addressing: digest and 1 + index of first entry with that value
+	std::vector<uint64_t> d_keys;
+	std::vector<uint32_t> d_first;
+	uint64_t d_mask{0};
+
+public:
+
+	// values shorter than MIN_LEN bytes are silently skipped
+	int add(const BIGNUM *, const std::string &, uint8_t);
+
+	int add(const std::string &hex, const std::string &, uint8_t);
+
+	// "hex,label,kind," lines, kind defaults to k if missing
+	int load(const std::string &, uint8_t k = KIND_MISC);
+
+	// parameters of OpenSSL's builtin curves and the RFC DH groups
+	int add_builtin(BN_CTX *);
+
+	void build();
+
+	struct probe {
+		const unsigned char *bin{nullptr};
+		size_t len{0};
+		const entry *first{nullptr};	// n entries equal to bin, or nullptr
+		size_t n{0};
+	};
+
+	// looks up all probes in one go, hashing before touching the table
+	void find(probe *, size_t) const;
+
+	// first of n entries equal to bin, or nullptr
+	const entry *find(const unsigned char *bin, size_t len, size_t &n) const;
+
+	const std::vector<entry> &entries() const
+	{
+		return d_entries;
+	}
+
+	size_t size()
+	{
+		return d_entries.size();
+	}
+};
+
+
+}
+
+#endif
+
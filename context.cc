@@ -0,0 +1,107 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <new>
+#include <vector>
+#include "context.h"
+#include "gf2m.h"
+
+extern "C" {
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+}
+
+
+namespace number {
+
+using namespace std;
+
+
+context::context()
+{
+	d_bn_ctx = BN_CTX_new();
+}
+
+
+context::~context()
+{
+	for (auto i = curves.begin(); i != curves.end(); ++i) {
+		delete i->gf2m;
+		EC_POINT_free(i->point);
+		EC_GROUP_free(i->group);
+	}
+
+	for (auto i = d_bn.begin(); i != d_bn.end(); ++i)
+		BN_free(*i);
+
+	BN_GENCB_free(d_gencb);
+	BN_CTX_free(d_bn_ctx);
+}
+
+
+// may be called from the workers of is_prime_parallel(), so only reads
+static int deadline_cb(int, int, BN_GENCB *cb)
+{
+	return !static_cast<context *>(BN_GENCB_get_arg(cb))->expired();
+}
+
+
+BN_GENCB *context::gencb()
+{
+	if (!d_has_deadline)
+		return nullptr;
+	if (!d_gencb) {
+		if (!(d_gencb = BN_GENCB_new()))
+			return nullptr;
+		BN_GENCB_set(d_gencb, deadline_cb, this);
+	}
+	return d_gencb;
+}
+
+
+BIGNUM *context::bn(unsigned int slot)
+{
+	if (slot >= d_bn.size())
+		d_bn.resize(slot + 1, nullptr);
+	if (!d_bn[slot])
+		d_bn[slot] = BN_new();
+	return d_bn[slot];
+}
+
+
+unsigned char *context::buf(unsigned int slot, size_t n)
+{
+	try {
+		if (slot >= d_buf.size())
+			d_buf.resize(slot + 1);
+		// never hand out nullptr for n == 0
+		if (d_buf[slot].size() < n || d_buf[slot].size() == 0)
+			d_buf[slot].resize(n > 0 ? n : 1);
+	} catch (...) {
+		return nullptr;
+	}
+
+	return d_buf[slot].data();
+}
+
+
+}
+
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_context_h
+#define number_context_h
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "catalog.h"
+
+extern "C" {
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+}
+
+
+namespace number {
+
+
+class gf2m_curve;
+
+
+struct ec_curve {
+	std::string name{""};
+	EC_GROUP *group{nullptr};
+	EC_POINT *point{nullptr};
+
+	// native membership test for binary curves, nullptr for prime curves
+	gf2m_curve *gf2m{nullptr};
+};
+
+
+// forms of a number that are looked up in the catalog
+enum canon_t {
+	CANON_BE	= 0,
+	CANON_LE,		// byte reversed
+	CANON_TRIM,		// trailing 0x00 (sign/padding of a swapped dump) removed
+	CANON_MPI,		// 1..4 byte length prefix and 0x00 sign byte of MPI/mpint removed
+	CANON_MAX
+};
+
+
+// Per-thread resources that are handed to each filter, so that the builtin
+// filters classify a number in steady state without allocating, other than
+// growing the output string. Slots grow on first use and are kept.
+// Not thread safe; each thread owns its own number object and thus its context.
+class context {
+
+	BN_CTX *d_bn_ctx{nullptr};
+
+	std::vector<BIGNUM *> d_bn;
+
+	std::vector<std::vector<unsigned char>> d_buf;
+
+	BN_GENCB *d_gencb{nullptr};
+
+	std::chrono::steady_clock::time_point d_deadline;
+
+	bool d_has_deadline{0};
+
+public:
+
+	context();
+
+	~context();
+
+	context(const context &) = delete;
+
+	context &operator=(const context &) = delete;
+
+	BN_CTX *bn_ctx()
+	{
+		return d_bn_ctx;
+	}
+
+	// scratch BIGNUM, content is undefined on return; nullptr on OOM
+	BIGNUM *bn(unsigned int slot);
+
+	// scratch buffer of at least n bytes; nullptr on OOM
+	unsigned char *buf(unsigned int slot, size_t n);
+
+	// time budget of the current number, ms == 0 for none
+	void deadline(unsigned int ms)
+	{
+		d_has_deadline = (ms > 0);
+		if (d_has_deadline)
+			d_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+		timed_out = 0;
+	}
+
+	bool expired() const
+	{
+		return d_has_deadline && std::chrono::steady_clock::now() >= d_deadline;
+	}
+
+	// callback for BN_is_prime_ex() and friends that cancels them once
+	// the deadline passed; nullptr without a deadline or on OOM
+	BN_GENCB *gencb();
+
+	// set by a filter that gave up because the budget was used up
+	bool timed_out{0};
+
+	// lazily set up by the filters on first use
+	std::vector<ec_curve> curves;
+	bool curves_init{0};
+
+	// match DB and constants
+	catalog cat;
+	bool cat_init{0};
+
+	// output of the base64 filters
+	std::string b64{""};
+
+	// canonical forms of the current number and their catalog entries,
+	// derived once per number on first use
+	std::string canon[CANON_MAX];
+	catalog::probe hits[CANON_MAX];
+	canon_t hit_form[CANON_MAX];
+	size_t nhits{0};
+	bool canon_valid{0};
+
+	// filter_prime spreads tests of numbers with at least prime_min_bits over threads
+	unsigned int prime_threads{1};
+	int prime_min_bits{4096};
+};
+
+
+}
+
+#endif
+
@@ -0,0 +1,73 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "digest.h"
+
+
+namespace number {
+
+
+static const uint64_t k0 = 0x9e3779b97f4a7c15ULL, k1 = 0xbf58476d1ce4e5b9ULL, k2 = 0x94d049bb133111ebULL;
+
+
+static inline uint64_t mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= k1;
+	x ^= x >> 27;
+	x *= k2;
+	x ^= x >> 31;
+	return x;
+}
+
+
+// 8 bytes per round, tail is zero padded and the length folded into the seed
+// so that "\x01" and "\x01\x00" do not collide
+uint64_t digest64(const void *vp, size_t len)
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(vp);
+	uint64_t h = k0 ^ (len * k1), w = 0;
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&w, p, 8);
+		h = mix(h ^ w) + k0;
+	}
+
+	if (len > 0) {
+		w = 0;
+		memcpy(&w, p, len);
+		h = mix(h ^ w) + k0;
+	}
+
+	return mix(h);
+}
+
+
+uint64_t digest64(const std::string &s)
+{
+	return digest64(s.c_str(), s.size());
+}
+
+
+}
+
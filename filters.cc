@@ -18,18 +18,28 @@
  * along with number.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #include <cstdio>
 #include <cstring>
 #include <string>
 #include <memory>
 #include <map>
+#include <algorithm>
 #include "base64.h"
+#include "digest.h"
+#include "context.h"
+#include "gf2m.h"
+#include "prime.h"
+#include "stats.h"
+#include "misc.h"
 #include "filters.h"
 
 extern "C" {
 #include <openssl/bn.h>
 #include <openssl/ec.h>
+#include <openssl/err.h>
 #include <openssl/obj_mac.h>
+#include <openssl/opensslv.h>
 }
 
 
@@ -38,194 +48,530 @@ namespace number {
 using namespace std;
 
 
-// unique_ptr helper type
-template<class T> using free_ptr = std::unique_ptr<T, void (*)(T *)>;
+// scratch buffer slots in the context
+enum {
+	BUF_BIN	= 0,
+	BUF_AUX	= 1,
+	BUF_WORDS = 2
+};
+
+// scratch BIGNUM slots in the context
+enum {
+	BN_DEC	= 0
+};
+
+// largest power of 10 that fits a BN_ULONG, as used by BN_bn2dec()
+#if BN_BYTES == 8
+static const BN_ULONG dec_conv = 10000000000000000000ULL;
+static const int dec_digits = 19;
+#else
+static const BN_ULONG dec_conv = 1000000000UL;
+static const int dec_digits = 9;
+#endif
+
+
+// same output as BN_bn2hex(), but into a re-used string
+static void bin2hex(const unsigned char *bin, int n, string &r)
+{
+	static const char *hex = "0123456789ABCDEF";
+
+	int i = 0;
+	for (; i < n && bin[i] == 0; ++i);
+
+	if (i == n) {
+		r += "0";
+		return;
+	}
+
+	for (; i < n; ++i) {
+		r += hex[bin[i] >> 4];
+		r += hex[bin[i] & 0xf];
+	}
+}
 
 
-int filter_bits(BIGNUM *bn)
+int filter_bits(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
-	printf("bits: %d\n", BN_num_bits(bn));
+	r += "bits: ";
+	r += to_string(BN_num_bits(bn));
+	r += "\n";
 	return 0;
 }
 
 
-int filter_bytes(BIGNUM *bn)
+int filter_bytes(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
-	printf("bytes: %d\n", BN_num_bytes(bn));
+	r += "bytes: ";
+	r += to_string(BN_num_bytes(bn));
+	r += "\n";
 	return 0;
 }
 
 
-int filter_dec(BIGNUM *bn)
+static const struct {
+	uint32_t flag;
+	const char *name;
+} stats_flags[] = {
+	{byte_stats::FLAG_WEIGHT, "weight"},
+	{byte_stats::FLAG_ENTROPY, "entropy"},
+	{byte_stats::FLAG_RUNS, "runs"},
+	{byte_stats::FLAG_ASCII, "ascii"},
+	{byte_stats::FLAG_REPEAT, "repeats"},
+	{byte_stats::FLAG_TOP, "top"}
+};
+
+
+int filter_stats(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
-	char *tmp = BN_bn2dec(bn);
-	printf("dec: %s\n", tmp);
-	OPENSSL_free(tmp);
+
+	int n = BN_num_bytes(bn);
+	unsigned char *bin = ctx.buf(BUF_BIN, n);
+	uint64_t *words = reinterpret_cast<uint64_t *>(ctx.buf(BUF_WORDS, (n + 2)*sizeof(uint64_t)));
+	if (!bin || !words)
+		return -1;
+	BN_bn2bin(bn, bin);
+
+	byte_stats st;
+	st.scan(bin, n, words);
+
+	char buf[256];
+	r += "stats: score ";
+	if (st.scored)
+		r += to_string(st.score);
+	else
+		r += "n/a";
+	if (st.flags) {
+		const char *sep = " (";
+		for (size_t i = 0; i < sizeof(stats_flags)/sizeof(stats_flags[0]); ++i) {
+			if (st.flags & stats_flags[i].flag) {
+				r += sep;
+				r += stats_flags[i].name;
+				sep = ",";
+			}
+		}
+		r += ")";
+	}
+	snprintf(buf, sizeof(buf), ", weight %.3f, entropy %.2f, run %zu, ascii %zu%%, repeats %u/%u, top gap %u\n",
+	         st.bits ? double(st.weight)/st.bits : 0.0, st.entropy, st.run, n ? st.printable*100/n : 0,
+	         st.rep32, st.rep64, st.top);
+	r += buf;
 	return 0;
 }
 
 
-int filter_hex(BIGNUM *bn)
+// same output as BN_bn2dec(), but with the context's scratch BIGNUM and buffer
+int filter_dec(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
-	char *tmp = BN_bn2hex(bn);
-	printf("hex: %s\n", tmp);
-	OPENSSL_free(tmp);
+
+	// log10(2) ~ 1233/4096 decimal digits per bit
+	size_t n = BN_num_bits(bn)*1233/4096 + 2;
+	BIGNUM *t = ctx.bn(BN_DEC);
+	char *dec = reinterpret_cast<char *>(ctx.buf(BUF_AUX, n));
+	if (!t || !dec || !BN_copy(t, bn))
+		return -1;
+
+	// chunks come out least significant first, so fill from the end
+	char *end = dec + n, *p = end;
+	do {
+		BN_ULONG w = BN_div_word(t, dec_conv);
+		if (w == static_cast<BN_ULONG>(-1))
+			return -1;
+		// all but the most significant chunk are zero padded
+		for (int i = 0; i < dec_digits && (w || !BN_is_zero(t)); ++i) {
+			*--p = '0' + w % 10;
+			w /= 10;
+		}
+	} while (!BN_is_zero(t));
+	if (p == end)
+		*--p = '0';
+
+	r += "dec: ";
+	if (BN_is_negative(bn))
+		r += "-";
+	r.append(p, end - p);
+	r += "\n";
 	return 0;
 }
 
 
-int filter_b64(BIGNUM *bn)
+int filter_hex(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
 	int n = BN_num_bytes(bn);
-	unique_ptr<unsigned char[]> tmp(new (nothrow) unsigned char[n]);
-	if (!tmp.get())
-		return -1;
-	if (BN_bn2bin(bn, tmp.get()) != n)
+	unsigned char *bin = ctx.buf(BUF_BIN, n);
+	if (!bin)
 		return -1;
+	BN_bn2bin(bn, bin);
 
-	string b64, tmps = string(reinterpret_cast<char *>(tmp.get()), n);
-	printf("base64: %s\n", b64_encode(tmps, b64).c_str());
+	r += "hex: ";
+	if (BN_is_negative(bn))
+		r += "-";
+	bin2hex(bin, n, r);
+	r += "\n";
 	return 0;
 }
 
 
-int filter_mpi(BIGNUM *bn)
+int filter_b64(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
-	int n = BN_bn2mpi(bn, nullptr);
-	unique_ptr<unsigned char[]> tmp(new (nothrow) unsigned char[n]);
-	if (!tmp.get())
+	int n = BN_num_bytes(bn);
+	unsigned char *tmp = ctx.buf(BUF_BIN, n);
+	if (!tmp)
 		return -1;
-	if (BN_bn2mpi(bn, tmp.get()) != n)
+	if (BN_bn2bin(bn, tmp) != n)
 		return -1;
 
-	string b64, tmps = string(reinterpret_cast<char *>(tmp.get()), n);
-	printf("MPI base64: %s\n", b64_encode(tmps, b64).c_str());
+	r += "base64: ";
+	r += b64_encode(reinterpret_cast<char *>(tmp), n, ctx.b64);
+	r += "\n";
 	return 0;
 }
 
 
-int filter_prime(BIGNUM *bn)
+int filter_mpi(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
-	int isprime = BN_is_prime_ex(bn, BN_prime_checks, nullptr, nullptr);
-	printf("prime: %s\n", isprime ? "Yes" : "No");
+
+	int n = BN_bn2mpi(bn, nullptr);
+	unsigned char *tmp = ctx.buf(BUF_BIN, n);
+	if (!tmp)
+		return -1;
+	if (BN_bn2mpi(bn, tmp) != n)
+		return -1;
+
+	r += "MPI base64: ";
+	r += b64_encode(reinterpret_cast<char *>(tmp), n, ctx.b64);
+	r += "\n";
+	return 0;
+}
+
+
+int filter_timeout(const char *name, context &ctx, string &r)
+{
+	ctx.timed_out = 1;
+	r += name;
+	r += ": timeout\n";
 	return 0;
 }
 
 
-int filter_ecpoint(BIGNUM *bn)
+int filter_prime(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
+	int isprime = 0;
+	if (ctx.prime_threads > 1 && BN_num_bits(bn) >= ctx.prime_min_bits)
+		isprime = is_prime_parallel(bn, ctx.prime_threads, 0, ctx.gencb());
+	else {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		isprime = BN_check_prime(bn, ctx.bn_ctx(), ctx.gencb());
+#else
+		isprime = BN_is_prime_ex(bn, BN_prime_checks, ctx.bn_ctx(), ctx.gencb());
+#endif
+	}
+	if (isprime < 0 && ctx.expired())
+		return filter_timeout("prime", ctx, r);
+	r += "prime: ";
+	r += isprime == 1 ? "Yes\n" : "No\n";
+	return 0;
+}
 
-	map<string, int> name2nid{
+
+static const struct {
+	const char *name;
+	int nid;
+} curve_nids[] = {
 #ifdef NID_brainpoolP160r1
-		{"brainpoolP160r1", NID_brainpoolP160r1},
-		{"brainpoolP160t1", NID_brainpoolP160t1},
-		{"brainpoolP192r1", NID_brainpoolP192r1},
-		{"brainpoolP192t1", NID_brainpoolP192t1},
-		{"brainpoolP224r1", NID_brainpoolP224r1},
-		{"brainpoolP224t1", NID_brainpoolP224t1},
-		{"brainpoolP256r1", NID_brainpoolP256r1},
-		{"brainpoolP256t1", NID_brainpoolP256t1},
-		{"brainpoolP320r1", NID_brainpoolP320r1},
-		{"brainpoolP320t1", NID_brainpoolP320t1},
-		{"brainpoolP384r1", NID_brainpoolP384r1},
-		{"brainpoolP384t1", NID_brainpoolP384t1},
-		{"brainpoolP512r1", NID_brainpoolP512r1},
-		{"brainpoolP512t1", NID_brainpoolP512t1},
+	{"brainpoolP160r1", NID_brainpoolP160r1},
+	{"brainpoolP160t1", NID_brainpoolP160t1},
+	{"brainpoolP192r1", NID_brainpoolP192r1},
+	{"brainpoolP192t1", NID_brainpoolP192t1},
+	{"brainpoolP224r1", NID_brainpoolP224r1},
+	{"brainpoolP224t1", NID_brainpoolP224t1},
+	{"brainpoolP256r1", NID_brainpoolP256r1},
+	{"brainpoolP256t1", NID_brainpoolP256t1},
+	{"brainpoolP320r1", NID_brainpoolP320r1},
+	{"brainpoolP320t1", NID_brainpoolP320t1},
+	{"brainpoolP384r1", NID_brainpoolP384r1},
+	{"brainpoolP384t1", NID_brainpoolP384t1},
+	{"brainpoolP512r1", NID_brainpoolP512r1},
+	{"brainpoolP512t1", NID_brainpoolP512t1},
 #endif
-		{"secp112r1", NID_secp112r1},
-		{"secp112r2", NID_secp112r2},
-		{"secp128r1", NID_secp128r1},
-		{"secp128r2", NID_secp128r2},
-		{"secp160k1", NID_secp160k1},
-		{"secp160r1", NID_secp160r1},
-		{"secp160r2", NID_secp160r2},
-		{"secp192k1", NID_secp192k1},
-		{"secp224k1", NID_secp224k1},
-		{"secp224r1", NID_secp224r1},
-		{"sect113r1", NID_sect113r1},
-		{"sect113r2", NID_sect113r2},
-		{"sect131r1", NID_sect131r1},
-		{"sect131r2", NID_sect131r2},
-		{"sect163k1", NID_sect163k1},
-		{"sect163r1", NID_sect163r1},
-		{"sect163r2", NID_sect163r2},
-		{"sect193r1", NID_sect193r1},
-		{"sect193r2", NID_sect193r2},
-		{"sect233k1", NID_sect233k1},
-		{"sect233r1", NID_sect233r1},
-		{"sect239k1", NID_sect239k1},
-		{"secp521r1", NID_secp521r1},
-		{"secp384r1", NID_secp384r1},
-		{"sect283k1", NID_sect283k1},
-		{"sect283r1", NID_sect283r1},
-		{"sect409k1", NID_sect409k1},
-		{"sect409r1", NID_sect409r1},
-		{"secp256k1", NID_secp256k1},
-		{"sect571k1", NID_sect571k1},
-		{"sect571r1", NID_sect571r1},
-		{"prime192v1", NID_X9_62_prime192v1},
-		{"prime192v2", NID_X9_62_prime192v2},
-		{"prime192v3", NID_X9_62_prime192v3},
-		{"prime239v1", NID_X9_62_prime239v1},
-		{"prime239v2", NID_X9_62_prime239v2},
-		{"prime239v3", NID_X9_62_prime239v3},
-		{"prime256v1", NID_X9_62_prime256v1}
-	};
+	{"secp112r1", NID_secp112r1},
+	{"secp112r2", NID_secp112r2},
+	{"secp128r1", NID_secp128r1},
+	{"secp128r2", NID_secp128r2},
+	{"secp160k1", NID_secp160k1},
+	{"secp160r1", NID_secp160r1},
+	{"secp160r2", NID_secp160r2},
+	{"secp192k1", NID_secp192k1},
+	{"secp224k1", NID_secp224k1},
+	{"secp224r1", NID_secp224r1},
+	{"sect113r1", NID_sect113r1},
+	{"sect113r2", NID_sect113r2},
+	{"sect131r1", NID_sect131r1},
+	{"sect131r2", NID_sect131r2},
+	{"sect163k1", NID_sect163k1},
+	{"sect163r1", NID_sect163r1},
+	{"sect163r2", NID_sect163r2},
+	{"sect193r1", NID_sect193r1},
+	{"sect193r2", NID_sect193r2},
+	{"sect233k1", NID_sect233k1},
+	{"sect233r1", NID_sect233r1},
+	{"sect239k1", NID_sect239k1},
+	{"secp521r1", NID_secp521r1},
+	{"secp384r1", NID_secp384r1},
+	{"sect283k1", NID_sect283k1},
+	{"sect283r1", NID_sect283r1},
+	{"sect409k1", NID_sect409k1},
+	{"sect409r1", NID_sect409r1},
+	{"secp256k1", NID_secp256k1},
+	{"sect571k1", NID_sect571k1},
+	{"sect571r1", NID_sect571r1},
+	{"prime192v1", NID_X9_62_prime192v1},
+	{"prime192v2", NID_X9_62_prime192v2},
+	{"prime192v3", NID_X9_62_prime192v3},
+	{"prime239v1", NID_X9_62_prime239v1},
+	{"prime239v2", NID_X9_62_prime239v2},
+	{"prime239v3", NID_X9_62_prime239v3},
+	{"prime256v1", NID_X9_62_prime256v1}
+};
+
+
+static const char *numbers_path = "/usr/share/number/numbers.txt";
+static const char *constants_path = "/usr/share/number/constants.txt";
+
+
+uint64_t tables_fingerprint()
+{
+	string s = "";
+	char buf[4096];
+	size_t r = 0;
 
-	free_ptr<EC_GROUP> ecg(nullptr, EC_GROUP_free);
-	free_ptr<BIGNUM> p(BN_new(), BN_free), a(BN_new(), BN_free), b(BN_new(), BN_free);
-	if (!p.get() || !a.get() || !b.get())
-		return -1;
+	// the builtin curves and DH groups come with OpenSSL
+	s += to_string(OPENSSL_VERSION_NUMBER) + "\n";
 
-	EC_POINT *ecp = nullptr;
-	string r = "";
-	for (auto it = name2nid.begin(); it != name2nid.end(); ++it) {
-		ecg.reset(EC_GROUP_new_by_curve_name(it->second));
-		if (!ecg.get())
+	for (auto path : {numbers_path, constants_path}) {
+		free_ptr<FILE> f(fopen(path, "r"), number::fclose);
+		if (!f.get())
 			continue;
-		// EC_GROUP_get_curve_GFp is as good as the GF2m variant, as its just a wrapper
-		// for the ->meth->group_get_curve() call
-		if (EC_GROUP_get_curve_GFp(ecg.get(), p.get(), a.get(), b.get(), nullptr) == 1) {
-			if (BN_cmp(p.get(), bn) == 0)
-				r += it->first + " prime,";
-			else if (BN_cmp(a.get(), bn) == 0)
-				r += it->first + " a,";
-			else if (BN_cmp(b.get(), bn) == 0)
-				r += it->first + " b,";
+		while ((r = fread(buf, 1, sizeof(buf), f.get())) > 0)
+			s.append(buf, r);
+	}
+
+	return digest64(s);
+}
+
+
+// load match DB and catalog of well-known constants once per context
+static void init_catalog(context &ctx)
+{
+	ctx.cat_init = 1;
+	ctx.cat.load(numbers_path, catalog::KIND_DB);
+	ctx.cat.load(constants_path);
+	ctx.cat.add_builtin(ctx.bn_ctx());
+	ctx.cat.build();
+}
+
+
+void init_tables(context &ctx)
+{
+	if (!ctx.cat_init)
+		init_catalog(ctx);
+}
+
+
+static const char *canon_suffix[CANON_MAX] = {"", " (le)", " (trimmed)", " (mpi)"};
+
+
+// Derive BE, LE, trimmed and MPI forms of bn once per number and
+// look all of them up in the catalog at once.
+static int lookup(BIGNUM *bn, context &ctx)
+{
+	if (ctx.canon_valid)
+		return 0;
+
+	init_tables(ctx);
+
+	string &be = ctx.canon[CANON_BE], &le = ctx.canon[CANON_LE];
+	string &trim = ctx.canon[CANON_TRIM], &mpi = ctx.canon[CANON_MPI];
+
+	be.resize(BN_num_bytes(bn));
+	if (be.size() > 0)
+		BN_bn2bin(bn, reinterpret_cast<unsigned char *>(&be[0]));
+
+	// reversed, without the leading zeros that were trailing ones
+	le.assign(be.rbegin(), be.rend());
+	le.erase(0, le.find_first_not_of('\0'));
+
+	trim = be;
+	trim.erase(trim.find_last_not_of('\0') + 1);
+
+	// 1..4 length bytes survive as leading zeros are stripped
+	mpi = "";
+	for (size_t hdr = 1; hdr <= 4 && hdr < be.size(); ++hdr) {
+		size_t len = 0;
+		for (size_t i = 0; i < hdr; ++i)
+			len = (len << 8) | static_cast<unsigned char>(be[i]);
+		if (len != be.size() - hdr)
+			continue;
+		mpi.assign(be, hdr, string::npos);
+		if (mpi.size() > 1 && mpi[0] == 0 && (mpi[1] & 0x80))
+			mpi.erase(0, 1);
+		else if (mpi[0] & 0x80)	// negative
+			mpi = "";
+		break;
+	}
+
+	// the catalog holds magnitudes of positive constants only
+	ctx.nhits = 0;
+	ctx.canon_valid = 1;
+	if (BN_is_negative(bn))
+		return 0;
+
+	for (int f = CANON_BE; f < CANON_MAX; ++f) {
+		const string &c = ctx.canon[f];
+		if (c.size() < catalog::MIN_LEN)
+			continue;
+		// e.g. LE == TRIM for 0x0100, report each hit once
+		size_t i = 0;
+		while (i < ctx.nhits && c != ctx.canon[ctx.hit_form[i]])
+			++i;
+		if (i < ctx.nhits)
+			continue;
+		ctx.hits[ctx.nhits].bin = reinterpret_cast<const unsigned char *>(c.data());
+		ctx.hits[ctx.nhits].len = c.size();
+		ctx.hit_form[ctx.nhits] = static_cast<canon_t>(f);
+		++ctx.nhits;
+	}
+	ctx.cat.find(ctx.hits, ctx.nhits);
+
+	return 0;
+}
+
+
+// append labels of catalog entries of the given kinds for any form of bn
+static void catalog_labels(BIGNUM *bn, context &ctx, uint8_t kinds, const char *sep, string &r)
+{
+	lookup(bn, ctx);
+
+	for (size_t i = 0; i < ctx.nhits; ++i) {
+		const catalog::entry *e = ctx.hits[i].first;
+		for (size_t j = 0; j < ctx.hits[i].n; ++j) {
+			if (!(e[j].kind & kinds))
+				continue;
+			r += e[j].label;
+			r += canon_suffix[ctx.hit_form[i]];
+			r += sep;
 		}
-		if ((ecp = EC_POINT_bn2point(ecg.get(), bn, nullptr, nullptr)) != nullptr) {
-			EC_POINT_free(ecp);
-			r += it->first + " point,";
+	}
+}
+
+
+// set up groups and a re-usable point once per context
+static void init_curves(context &ctx)
+{
+	ctx.curves_init = 1;
+
+	for (size_t i = 0; i < sizeof(curve_nids)/sizeof(curve_nids[0]); ++i) {
+		ec_curve c;
+		c.name = curve_nids[i].name;
+		if (!(c.group = EC_GROUP_new_by_curve_name(curve_nids[i].nid)))
+			continue;
+		if (!(c.point = EC_POINT_new(c.group))) {
+			EC_GROUP_free(c.group);
+			continue;
 		}
+
+		// OpenSSL's generic GF2m decoding is slow, binary curves get the native check
+		unique_ptr<gf2m_curve> g(new (nothrow) gf2m_curve);
+		if (g.get() && g->init(c.group, ctx.bn_ctx()) == 0)
+			c.gf2m = g.release();
+
+		ctx.curves.push_back(c);
 	}
 
-	printf("ec: %s\n", r.size() > 0 ? r.c_str() : "No");
+	// report in name order
+	sort(ctx.curves.begin(), ctx.curves.end(), [](const ec_curve &c1, const ec_curve &c2) { return c1.name < c2.name; });
+}
+
+
+int filter_ecpoint(BIGNUM *bn, context &ctx, string &r)
+{
+	if (!bn)
+		return -1;
+
+	if (!ctx.curves_init)
+		init_curves(ctx);
+
+	// same encoding that EC_POINT_bn2point() would use, but without allocations
+	int n = BN_num_bytes(bn);
+	unsigned char *bin = ctx.buf(BUF_BIN, n > 0 ? n : 1);
+	if (!bin)
+		return -1;
+	if (n == 0) {
+		bin[0] = 0;
+		n = 1;
+	} else
+		BN_bn2bin(bn, bin);
+
+	string::size_type start = r.size();
+	r += "ec: ";
+
+	// curve parameters, orders and generators
+	catalog_labels(bn, ctx, catalog::KIND_EC, ",", r);
+
+	// the catalog labels above are cheap and kept, only the point checks give up
+	// and end the line as "ec: timeout" or "ec: <labels so far>,timeout"
+	bool expired = false;
+	for (auto it = ctx.curves.begin(); it != ctx.curves.end(); ++it) {
+		if ((expired = ctx.expired()))
+			break;
+		bool on_curve = false;
+		if (it->gf2m)
+			on_curve = it->gf2m->is_point(bin, n);
+		else
+			on_curve = (EC_POINT_oct2point(it->group, it->point, bin, n, ctx.bn_ctx()) == 1);
+		if (on_curve) {
+			r += it->name;
+			r += " point,";
+		}
+	}
+
+	// failed decodings leave entries in the error queue
+	ERR_clear_error();
+
+	if (expired) {
+		ctx.timed_out = 1;
+		r += "timeout\n";
+		return 0;
+	}
+
+	if (r.size() == start + 4)
+		r += "No";
+	r += "\n";
 
 	return 0;
 }
 
 
-int filter_le(BIGNUM *bn)
+int filter_le(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
@@ -234,27 +580,27 @@ int filter_le(BIGNUM *bn)
 	if ((n = BN_num_bytes(bn)) < 0)
 		return -1;
 
-	unique_ptr<unsigned char[]> bin(new (nothrow) unsigned char[n]);
-	if (!bin.get())
+	unsigned char *bin = ctx.buf(BUF_BIN, n), *le = ctx.buf(BUF_AUX, n);
+	if (!bin || !le)
 		return -1;
 
-	BN_bn2bin(bn, bin.get());
+	BN_bn2bin(bn, bin);
+	for (int i = 0; i < n; ++i)
+		le[i] = bin[n - i - 1];
 
-	free_ptr<BIGNUM> lebn(BN_lebin2bn(bin.get(), n, nullptr), BN_free);
-	if (!lebn.get())
-		return -1;
-
-	printf("le: %s\n", BN_bn2hex(lebn.get()));
+	r += "le: ";
+	bin2hex(le, n, r);
+	r += "\n";
 	return 0;
 }
 
 
-int filter_hash(BIGNUM *bn)
+int filter_hash(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
-	map<int, string> bytes2hash{
+	static const map<int, string> bytes2hash{
 		{16, "MD4, MD5"},
 		{20, "SHA1, RIPEMD-160"},
 		{24, "TIGER"},
@@ -262,64 +608,45 @@ int filter_hash(BIGNUM *bn)
 		{64, "SHA512"}
 	};
 
-	int n = BN_num_bytes(bn);
-	auto it = bytes2hash.find(n);
-	printf("hash: %s\n", (it == bytes2hash.end()) ? "No" : it->second.c_str());
-	return 0;
-}
+	auto it = bytes2hash.find(BN_num_bytes(bn));
+	string::size_type start = r.size();
+	r += "hash: ";
+	if (it != bytes2hash.end()) {
+		r += it->second;
+		r += ", ";
+	}
 
+	// IVs and round constants
+	catalog_labels(bn, ctx, catalog::KIND_HASH, ", ", r);
 
-// helper function to remove int return
-void fclose(FILE *f)
-{
-	::fclose(f);
+	if (r.size() == start + 6)
+		r += "No";
+	else
+		r.erase(r.size() - 2);
+	r += "\n";
+	return 0;
 }
 
 
-int filter_match(BIGNUM *bn)
+int filter_match(BIGNUM *bn, context &ctx, string &r)
 {
 	if (!bn)
 		return -1;
 
-	// check match DB
-	free_ptr<FILE> f(fopen("/usr/share/number/numbers.txt", "r"), number::fclose);
-	if (!f.get())
-		return -1;
+	string::size_type start = r.size();
+	r += "match: ";
 
-	bool match = 0;
-	char buf[8192] = {0};
-	string line = "", s1 = "", s2 = "";
-	string::size_type idx = 0;
-	free_ptr<BIGNUM> moduli(nullptr, BN_free);
-	BIGNUM *bn2 = nullptr;
+	// match DB, DH groups and other catalog entries
+	catalog_labels(bn, ctx, catalog::KIND_DB|catalog::KIND_DH|catalog::KIND_MISC, ", ", r);
 
-	for (;!feof(f.get());) {
-		memset(buf, 0, sizeof(buf));
-		if (!fgets(buf, sizeof(buf) - 1, f.get()))
-			break;
-		line = buf;
-		if ((idx = line.find(",")) == string::npos)
-			continue;
-		s1 = line.substr(0, idx);
-		line.erase(0, idx + 1);
-		if ((idx = line.find(",")) == string::npos)
-			continue;
-		s2 = line.substr(0, idx);
-		bn2 = nullptr;
-		if (BN_hex2bn(&bn2, s1.c_str()) == 0)
-			continue;
-		moduli.reset(bn2);
-		if (BN_cmp(bn, moduli.get()) == 0) {
-			match = 1;
-			break;
-		}
-	}
-
-	printf("match: %s\n", match ? s2.c_str() : "No");
+	if (r.size() == start + 7)
+		r += "No";
+	else
+		r.erase(r.size() - 2);
+	r += "\n";
 	return 0;
 }
 
 
-
 }
 
@@ -22,33 +22,121 @@
 #ifndef number_filters_h
 #define number_filters_h
 
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include "context.h"
+
 extern "C" {
 #include <openssl/bn.h>
 }
 
 namespace number {
 
-int filter_bits(BIGNUM *);
+int filter_bits(BIGNUM *, context &, std::string &);
+
+int filter_bytes(BIGNUM *, context &, std::string &);
+
+int filter_stats(BIGNUM *, context &, std::string &);
+
+int filter_hex(BIGNUM *, context &, std::string &);
+
+int filter_dec(BIGNUM *, context &, std::string &);
+
+int filter_prime(BIGNUM *, context &, std::string &);
+
+int filter_b64(BIGNUM *, context &, std::string &);
+
+int filter_mpi(BIGNUM *, context &, std::string &);
+
+int filter_le(BIGNUM *, context &, std::string &);
+
+int filter_ecpoint(BIGNUM *, context &, std::string &);
+
+int filter_hash(BIGNUM *, context &, std::string &);
+
+int filter_match(BIGNUM *, context &, std::string &);
+
+// load match DB and catalog into the context, if not done yet
+void init_tables(context &);
+
+// digest of the match DB, the constants and the OpenSSL version, which
+// all determine what the catalog based filters report
+uint64_t tables_fingerprint();
+
+// "name: timeout" result for filters that ran out of the numbers time budget
+int filter_timeout(const char *, context &, std::string &);
+
+
+typedef int (*filter_fn)(BIGNUM *, context &, std::string &);
+
+
+enum filter_mask : uint32_t {
+	FILTER_BITS	= 0x1,
+	FILTER_BYTES	= 0x2,
+	FILTER_PRIME	= 0x4,
+	FILTER_ECPOINT	= 0x8,
+	FILTER_HASH	= 0x10,
+	FILTER_MATCH	= 0x20,
+	FILTER_STATS	= 0x40,
+	FILTER_HEX	= 0x100,
+	FILTER_DEC	= 0x200,
+	FILTER_B64	= 0x400,
+	FILTER_MPI	= 0x800,
+	FILTER_LE	= 0x1000,
+
+	FILTER_DEFAULT	= FILTER_BITS|FILTER_BYTES|FILTER_PRIME|FILTER_ECPOINT|FILTER_HASH|FILTER_MATCH|FILTER_STATS
+};
 
-int filter_bytes(BIGNUM *);
 
-int filter_hex(BIGNUM *);
+struct filter_desc {
+	const char *name;
+	uint32_t bit;
+	filter_fn fn;
+};
 
-int filter_dec(BIGNUM *);
 
-int filter_prime(BIGNUM *);
+// All built-in filters, in output order. Being constexpr, the dispatch
+// below resolves each entry at compile time and can inline the calls.
+static constexpr filter_desc filter_table[] = {
+	{"bits", FILTER_BITS, filter_bits},
+	{"bytes", FILTER_BYTES, filter_bytes},
+	{"stats", FILTER_STATS, filter_stats},
+	{"prime", FILTER_PRIME, filter_prime},
+	{"ecpoint", FILTER_ECPOINT, filter_ecpoint},
+	{"hash", FILTER_HASH, filter_hash},
+	{"match", FILTER_MATCH, filter_match},
+	{"hex", FILTER_HEX, filter_hex},
+	{"dec", FILTER_DEC, filter_dec},
+	{"base64", FILTER_B64, filter_b64},
+	{"mpi", FILTER_MPI, filter_mpi},
+	{"le", FILTER_LE, filter_le}
+};
 
-int filter_b64(BIGNUM *);
+static constexpr size_t filter_count = sizeof(filter_table)/sizeof(filter_table[0]);
 
-int filter_mpi(BIGNUM *);
 
-int filter_le(BIGNUM *);
+// unrolled walk over filter_table, calling f for each entry enabled in mask
+template<size_t I, size_t N = filter_count>
+struct filter_dispatch {
+	template<typename F>
+	static void each(uint32_t mask, F &f)
+	{
+		if (mask & filter_table[I].bit)
+			f(filter_table[I]);
+		filter_dispatch<I + 1, N>::each(mask, f);
+	}
+};
 
-int filter_ecpoint(BIGNUM *);
 
-int filter_hash(BIGNUM *);
+template<size_t N>
+struct filter_dispatch<N, N> {
+	template<typename F>
+	static void each(uint32_t, F &)
+	{
+	}
+};
 
-int filter_match(BIGNUM *);
 
 }
 
@@ -0,0 +1,432 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "gf2m.h"
+
+extern "C" {
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/obj_mac.h>
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#define NUMBER_HAVE_PCLMUL 1
+#endif
+
+
+namespace number {
+
+using namespace std;
+
+
+// 64x64 -> 128 carry-less multiplication with a 4bit window, the
+// top 3 bits of a are added separately so table entries fit 64bit
+static inline void clmul_portable(uint64_t a, uint64_t b, uint64_t &lo, uint64_t &hi)
+{
+	uint64_t tab[16], a1 = a & 0x1fffffffffffffffULL;
+
+	tab[0] = 0;
+	tab[1] = a1;
+	for (int i = 2; i < 16; i += 2) {
+		tab[i] = tab[i >> 1] << 1;
+		tab[i + 1] = tab[i] ^ a1;
+	}
+
+	lo = hi = 0;
+	for (int i = 60; i >= 0; i -= 4) {
+		hi = (hi << 4) | (lo >> 60);
+		lo = (lo << 4) ^ tab[(b >> i) & 0xf];
+	}
+
+	for (int k = 61; k < 64; ++k) {
+		if ((a >> k) & 1) {
+			lo ^= b << k;
+			hi ^= b >> (64 - k);
+		}
+	}
+}
+
+
+static void polymul_portable(const uint64_t *a, const uint64_t *b, uint64_t *r, unsigned int n)
+{
+	uint64_t lo = 0, hi = 0;
+
+	memset(r, 0, 2*n*sizeof(uint64_t));
+	for (unsigned int i = 0; i < n; ++i) {
+		for (unsigned int j = 0; j < n; ++j) {
+			clmul_portable(a[i], b[j], lo, hi);
+			r[i + j] ^= lo;
+			r[i + j + 1] ^= hi;
+		}
+	}
+}
+
+
+#ifdef NUMBER_HAVE_PCLMUL
+
+__attribute__((target("pclmul,sse2")))
+static void polymul_pclmul(const uint64_t *a, const uint64_t *b, uint64_t *r, unsigned int n)
+{
+	__m128i acc[2*gf2m_curve::MAX_WORDS];
+
+	for (unsigned int i = 0; i < 2*n; ++i)
+		acc[i] = _mm_setzero_si128();
+
+	// acc[i + j] collects the full 128bit products, split into words below
+	for (unsigned int i = 0; i < n; ++i) {
+		__m128i ai = _mm_cvtsi64_si128(a[i]);
+		for (unsigned int j = 0; j < n; ++j)
+			acc[i + j] = _mm_xor_si128(acc[i + j], _mm_clmulepi64_si128(ai, _mm_cvtsi64_si128(b[j]), 0x00));
+	}
+
+	r[0] = 0;
+	for (unsigned int i = 0; i < 2*n - 1; ++i) {
+		r[i] ^= _mm_cvtsi128_si64(acc[i]);
+		r[i + 1] = _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc[i], acc[i]));
+	}
+}
+
+#endif
+
+
+typedef void (*polymul_t)(const uint64_t *, const uint64_t *, uint64_t *, unsigned int);
+
+
+static polymul_t select_polymul()
+{
+#ifdef NUMBER_HAVE_PCLMUL
+	if (__builtin_cpu_supports("pclmul"))
+		return polymul_pclmul;
+#endif
+	return polymul_portable;
+}
+
+
+static const polymul_t polymul = select_polymul();
+
+
+// squaring is linear in GF(2)[t]: interleave zero bits
+static inline uint64_t spread32(uint64_t x)
+{
+	x &= 0xffffffffULL;
+	x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+	x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+	return x;
+}
+
+
+gf2m_curve::gf2m_curve()
+{
+	memset(d_a, 0, sizeof(d_a));
+	memset(d_b, 0, sizeof(d_b));
+	memset(d_trmask, 0, sizeof(d_trmask));
+}
+
+
+int gf2m_curve::init(const EC_GROUP *grp, BN_CTX *ctx)
+{
+#ifdef OPENSSL_NO_EC2M
+	return -1;
+#else
+	if (!grp || !ctx || EC_GROUP_get_field_type(grp) != NID_X9_62_characteristic_two_field)
+		return -1;
+
+	BN_CTX_start(ctx);
+	BIGNUM *p = BN_CTX_get(ctx), *a = BN_CTX_get(ctx), *b = BN_CTX_get(ctx);
+	if (!b || EC_GROUP_get_curve(grp, p, a, b, ctx) != 1) {
+		BN_CTX_end(ctx);
+		return -1;
+	}
+
+	// exponents of the reduction polynomial in descending order, terminated by -1
+	int arr[16], n = 0, max = BN_GF2m_poly2arr(p, arr, sizeof(arr)/sizeof(arr[0]));
+	if (max < 1 || max > int(sizeof(arr)/sizeof(arr[0])))
+		max = 0;
+	for (; n < max && arr[n] != -1; ++n);
+	if (n < 3 || arr[n - 1] != 0 || arr[0] > 64*MAX_WORDS) {
+		BN_CTX_end(ctx);
+		return -1;
+	}
+
+	d_m = arr[0];
+	d_words = (d_m + 63)/64;
+	d_flen = (EC_GROUP_get_degree(grp) + 7)/8;
+
+	d_terms.clear();
+	for (int i = 1; i < n - 1; ++i) {
+		term t;
+		t.k = arr[i];
+		t.hi_words = (d_m - t.k)/64;
+		t.hi_shift = (d_m - t.k) % 64;
+		d_terms.push_back(t);
+	}
+
+	unsigned char buf[2*8*MAX_WORDS];
+	if (BN_bn2binpad(a, buf, d_flen) < 0 || BN_bn2binpad(b, buf + d_flen, d_flen) < 0) {
+		BN_CTX_end(ctx);
+		return -1;
+	}
+	load(buf, d_a);
+	load(buf + d_flen, d_b);
+	BN_CTX_end(ctx);
+
+	// Tr(t^i) via Newton's identities on the power sums of the roots of the
+	// reduction polynomial f, so that Tr() becomes a masked parity:
+	// s_0 = m, s_i = sum_{j<i} f_{m-j} s_{i-j} + i f_{m-i}
+	vector<unsigned char> s(d_m, 0);
+	s[0] = d_m & 1;
+	for (unsigned int i = 1; i < d_m; ++i) {
+		unsigned char si = 0;
+		for (auto t = d_terms.begin(); t != d_terms.end(); ++t) {
+			unsigned int j = d_m - t->k;
+			if (j < i)
+				si ^= s[i - j];
+			else if (j == i)
+				si ^= (i & 1);
+		}
+		s[i] = si;
+	}
+
+	memset(d_trmask, 0, sizeof(d_trmask));
+	for (unsigned int i = 0; i < d_m; ++i) {
+		if (s[i])
+			d_trmask[i/64] |= 1ULL<<(i % 64);
+	}
+
+	return 0;
+#endif
+}
+
+
+void gf2m_curve::load(const unsigned char *buf, elem &e) const
+{
+	memset(e, 0, sizeof(e));
+	for (unsigned int i = 0; i < d_flen; ++i) {
+		unsigned int idx = d_flen - i - 1;
+		e[idx/8] |= uint64_t(buf[i])<<(8*(idx % 8));
+	}
+}
+
+
+bool gf2m_curve::in_field(const elem &e) const
+{
+	if ((d_m % 64) && (e[d_words - 1] >> (d_m % 64)))
+		return 0;
+	return 1;
+}
+
+
+bool gf2m_curve::is_zero(const elem &e) const
+{
+	uint64_t r = 0;
+	for (unsigned int i = 0; i < d_words; ++i)
+		r |= e[i];
+	return r == 0;
+}
+
+
+// word-wise reduction of a 2*d_words product, as in BN_GF2m_mod_arr()
+void gf2m_curve::reduce(uint64_t *z, elem &r) const
+{
+	unsigned int dN = d_m/64, d0 = d_m % 64;
+	uint64_t zz = 0;
+
+	for (unsigned int j = 2*d_words - 1; j > dN;) {
+		if ((zz = z[j]) == 0) {
+			--j;
+			continue;
+		}
+		z[j] = 0;
+
+		for (auto t = d_terms.begin(); t != d_terms.end(); ++t) {
+			z[j - t->hi_words] ^= zz >> t->hi_shift;
+			if (t->hi_shift)
+				z[j - t->hi_words - 1] ^= zz << (64 - t->hi_shift);
+		}
+
+		// t^0 component
+		z[j - dN] ^= zz >> d0;
+		if (d0)
+			z[j - dN - 1] ^= zz << (64 - d0);
+	}
+
+	// bits >= m in the top word
+	while ((zz = z[dN] >> d0) != 0) {
+		if (d0)
+			z[dN] = (z[dN] << (64 - d0)) >> (64 - d0);
+		else
+			z[dN] = 0;
+
+		z[0] ^= zz;
+		for (auto t = d_terms.begin(); t != d_terms.end(); ++t) {
+			unsigned int w = t->k/64, b = t->k % 64;
+			z[w] ^= zz << b;
+			if (b && (zz >> (64 - b)))
+				z[w + 1] ^= zz >> (64 - b);
+		}
+	}
+
+	memcpy(r, z, d_words*sizeof(uint64_t));
+}
+
+
+void gf2m_curve::mul(const elem &a, const elem &b, elem &r) const
+{
+	uint64_t z[2*MAX_WORDS];
+
+	polymul(a, b, z, d_words);
+	reduce(z, r);
+}
+
+
+void gf2m_curve::sqr(const elem &a, elem &r) const
+{
+	uint64_t z[2*MAX_WORDS];
+
+	for (unsigned int i = 0; i < d_words; ++i) {
+		z[2*i] = spread32(a[i]);
+		z[2*i + 1] = spread32(a[i] >> 32);
+	}
+	reduce(z, r);
+}
+
+
+// Itoh-Tsujii: a^-1 = a^(2^m - 2) = (a^(2^(m-1) - 1))^2
+void gf2m_curve::inv(const elem &a, elem &r) const
+{
+	elem b, t;
+	unsigned int k = d_m - 1, e = 1;
+	int top = 31;
+
+	memcpy(b, a, sizeof(b));
+	for (; top >= 0 && !((k >> top) & 1); --top);
+
+	// invariant: b = a^(2^e - 1)
+	for (int bit = top - 1; bit >= 0; --bit) {
+		memcpy(t, b, sizeof(t));
+		for (unsigned int i = 0; i < e; ++i)
+			sqr(t, t);
+		mul(t, b, b);
+		e *= 2;
+
+		if ((k >> bit) & 1) {
+			sqr(b, b);
+			mul(b, a, b);
+			++e;
+		}
+	}
+
+	sqr(b, r);
+}
+
+
+unsigned int gf2m_curve::trace(const elem &a) const
+{
+	uint64_t x = 0;
+	for (unsigned int i = 0; i < d_words; ++i)
+		x ^= a[i] & d_trmask[i];
+	return __builtin_parityll(x);
+}
+
+
+// mirrors ec_GF2m_simple_oct2point(): compressed points exist iff
+// z^2 + z = x + a + b/x^2 is solvable, i.e. Tr(x + a + b/x^2) == 0
+bool gf2m_curve::is_point(const unsigned char *buf, size_t len) const
+{
+	if (d_m == 0 || len == 0)
+		return 0;
+
+	unsigned int form = buf[0] & ~1U, y_bit = buf[0] & 1;
+
+	if (form != 0 && form != POINT_CONVERSION_COMPRESSED &&
+	    form != POINT_CONVERSION_UNCOMPRESSED && form != POINT_CONVERSION_HYBRID)
+		return 0;
+	if ((form == 0 || form == POINT_CONVERSION_UNCOMPRESSED) && y_bit)
+		return 0;
+
+	// point at infinity
+	if (form == 0)
+		return len == 1;
+
+	size_t enc_len = (form == POINT_CONVERSION_COMPRESSED) ? 1 + d_flen : 1 + 2*d_flen;
+	if (len != enc_len)
+		return 0;
+
+	elem x, y, t1, t2;
+
+	load(buf + 1, x);
+	if (!in_field(x))
+		return 0;
+
+	if (form == POINT_CONVERSION_COMPRESSED) {
+		if (is_zero(x))
+			return 1;
+		sqr(x, t1);
+		inv(t1, t2);
+		mul(t2, d_b, t1);
+		for (unsigned int i = 0; i < d_words; ++i)
+			t1[i] ^= x[i] ^ d_a[i];
+		return trace(t1) == 0;
+	}
+
+	load(buf + 1 + d_flen, y);
+	if (!in_field(y))
+		return 0;
+
+	if (form == POINT_CONVERSION_HYBRID) {
+		if (is_zero(x)) {
+			if (y_bit)
+				return 0;
+		} else {
+			inv(x, t1);
+			mul(y, t1, t2);
+			if ((t2[0] & 1) != y_bit)
+				return 0;
+		}
+	}
+
+	// y^2 + xy = x^3 + ax^2 + b  <=>  y(y + x) = x^2(x + a) + b
+	for (unsigned int i = 0; i < d_words; ++i) {
+		t1[i] = y[i] ^ x[i];
+		t2[i] = x[i] ^ d_a[i];
+	}
+	mul(y, t1, t1);
+
+	elem x2;
+	sqr(x, x2);
+	mul(x2, t2, t2);
+	for (unsigned int i = 0; i < d_words; ++i)
+		t2[i] ^= d_b[i];
+
+	return memcmp(t1, t2, d_words*sizeof(uint64_t)) == 0;
+}
+
+
+}
+
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_gf2m_h
+#define number_gf2m_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+extern "C" {
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+}
+
+
+namespace number {
+
+
+// Point membership test for curves y^2 + xy = x^3 + ax^2 + b over GF(2^m),
+// in polynomial basis with 64bit words and carry-less multiplication.
+// Accepts exactly the encodings that EC_POINT_oct2point() accepts for the group.
+class gf2m_curve {
+
+public:
+
+	enum {
+		MAX_WORDS	= 9	// sect571
+	};
+
+	typedef uint64_t elem[MAX_WORDS];
+
+private:
+
+	// middle term of the reduction polynomial, precomputed word/bit offsets
+	struct term {
+		unsigned int k;
+		unsigned int hi_words, hi_shift;	// for folding t^m -> t^(m - (m-k))
+	};
+
+	unsigned int d_m{0}, d_words{0}, d_flen{0};
+
+	std::vector<term> d_terms;
+
+	elem d_a, d_b, d_trmask;
+
+	void load(const unsigned char *, elem &) const;
+
+	bool in_field(const elem &) const;
+
+	bool is_zero(const elem &) const;
+
+	void reduce(uint64_t *, elem &) const;
+
+	void mul(const elem &, const elem &, elem &) const;
+
+	void sqr(const elem &, elem &) const;
+
+	void inv(const elem &, elem &) const;
+
+	unsigned int trace(const elem &) const;
+
+public:
+
+	gf2m_curve();
+
+	// returns -1 if group is not a supported binary curve
+	int init(const EC_GROUP *, BN_CTX *);
+
+	bool is_point(const unsigned char *, size_t) const;
+};
+
+
+}
+
+#endif
+
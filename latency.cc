@@ -0,0 +1,100 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+#include "latency.h"
+
+
+namespace number {
+
+
+latency_hist::latency_hist()
+{
+	memset(d_buckets, 0, sizeof(d_buckets));
+}
+
+
+unsigned int latency_hist::bucket(uint64_t ns)
+{
+	if (ns < LINEAR)
+		return ns;
+
+	unsigned int e = 63 - __builtin_clzll(ns);
+	return LINEAR + (e - SUB_BITS - 1)*SUB + ((ns >> (e - SUB_BITS)) & (SUB - 1));
+}
+
+
+uint64_t latency_hist::upper(unsigned int b)
+{
+	if (b < LINEAR)
+		return b;
+
+	unsigned int e = (b - LINEAR)/SUB + SUB_BITS + 1, sub = (b - LINEAR) % SUB;
+	uint64_t lo = (uint64_t(SUB + sub)) << (e - SUB_BITS);
+	return lo + ((uint64_t(1) << (e - SUB_BITS)) - 1);
+}
+
+
+void latency_hist::record(uint64_t ns)
+{
+	++d_buckets[bucket(ns)];
+	++d_count;
+	if (ns > d_max)
+		d_max = ns;
+}
+
+
+void latency_hist::merge(const latency_hist &o)
+{
+	for (unsigned int b = 0; b < BUCKETS; ++b)
+		d_buckets[b] += o.d_buckets[b];
+	d_count += o.d_count;
+	d_timeouts += o.d_timeouts;
+	if (o.d_max > d_max)
+		d_max = o.d_max;
+}
+
+
+uint64_t latency_hist::percentile(double q) const
+{
+	if (d_count == 0)
+		return 0;
+
+	// rank of the sample in 1..count
+	uint64_t rank = static_cast<uint64_t>(q*d_count + 0.5);
+	if (rank < 1)
+		rank = 1;
+	if (rank > d_count)
+		rank = d_count;
+
+	uint64_t seen = 0;
+	for (unsigned int b = 0; b < BUCKETS; ++b) {
+		seen += d_buckets[b];
+		if (seen >= rank)
+			return upper(b) < d_max ? upper(b) : d_max;
+	}
+	return d_max;
+}
+
+
+}
+
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_latency_h
+#define number_latency_h
+
+#include <cstdint>
+#include <sys/types.h>
+
+
+namespace number {
+
+
+// Log-linear latency histogram in ns: exact below 16ns, then 8 sub-buckets
+// per power of two, so percentiles are within 12.5% of the real value.
+class latency_hist {
+
+	enum { SUB_BITS = 3, SUB = 1<<SUB_BITS, LINEAR = 2*SUB, BUCKETS = LINEAR + (64 - SUB_BITS - 1)*SUB };
+
+	uint64_t d_buckets[BUCKETS];
+
+	uint64_t d_count{0}, d_timeouts{0}, d_max{0};
+
+	static unsigned int bucket(uint64_t);
+
+	static uint64_t upper(unsigned int);
+
+public:
+
+	latency_hist();
+
+	void record(uint64_t ns);
+
+	void merge(const latency_hist &);
+
+	void timeout()
+	{
+		++d_timeouts;
+	}
+
+	// upper bound of the bucket holding the q-quantile, 0 <= q <= 1
+	uint64_t percentile(double q) const;
+
+	uint64_t count() const
+	{
+		return d_count;
+	}
+
+	uint64_t timeouts() const
+	{
+		return d_timeouts;
+	}
+
+	uint64_t max() const
+	{
+		return d_max;
+	}
+};
+
+
+}
+
+#endif
+
@@ -18,24 +18,73 @@
  * along with number.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <ctime>
+#include <fcntl.h>
 #include <unistd.h>
+#include "misc.h"
 #include "filters.h"
 #include "number.h"
+#include "cache.h"
+#include "context.h"
+#include "scan.h"
+#include "shard.h"
+#include "pipeline.h"
 
 using namespace std;
 using namespace number;
 
 
+enum modes : uint32_t {
+	MODE_INVALID	= 0,
+	INMODE_HEX	= 1,
+	INMODE_DEC	= 2,
+	INMODE_B64	= 4,
+	INMODE_MPI	= 8,
+	OUTMODE_HEX	= 0x1000,
+	OUTMODE_DEC	= 0x2000,
+	OUTMODE_B64	= 0x4000,
+	OUTMODE_MPI	= 0x8000,
+	OUTMODE_LE	= 0x10000,
+	MODE_BATCH	= 0x100000,
+	MODE_SCAN	= 0x200000,
+	MODE_SHARD	= 0x400000,
+	MODE_MERGE	= 0x800000
+};
+
+
 void usage()
 {
 	printf("\nnumber (C) 2018 Sebastian Krahmer -- https://github.com/stealth/number\n\n"
-	       " number <-xdbm number> [-XDBM]\n\n"
+	       " number <-xdbm number> [-XDBML] [-C file] [-T N] [-t ms]\n"
+	       " number <-f file> [-i xdbm] [-c N] [-C file] [-T N] [-t ms] [-w N] [-XDBML]\n"
+	       " number <-f file> <-S [k/]N> <-O base> [-i xdbm] [-c N] [-C file] [-T N] [-t ms] [-XDBML]\n"
+	       " number <-J N> <-O base>\n"
+	       " number <-s file> [-T N]\n\n"
 	       "\t-x input is hex\n"
 	       "\t-d input is dec\n"
 	       "\t-b input is base64 BIGNUM (base64(BN_bn2bin()) output)\n"
 	       "\t-m input is base64 MPI\n"
+	       "\t-f batch mode, one number per line from file (- for stdin)\n"
+	       "\t-i input format for -f: x, d, b or m (default x)\n"
+	       "\t-c result cache size in numbers for -f (default 65536, 0 disables)\n"
+	       "\t-C load/save result cache from/to file\n"
+	       "\t-w classify -f input on N worker threads fed by asynchronous I/O\n"
+	       "\t   (io_uring or epoll/pread; 0 for all cores; not with -S)\n"
+	       "\t-S split -f file into N shards by byte range and run shard k, or all that\n"
+	       "\t   are not claimed by another process; resumes from checkpoints\n"
+	       "\t-O output base name for -S and -J: base.k, base.k.ckpt, base.k.lock\n"
+	       "\t-J merge the output of N finished shards to stdout\n"
+	       "\t-s scan binary file for embedded known numbers (BE and LE)\n"
+	       "\t-T use N threads for -s and for primality tests of numbers >= 4096 bits\n"
+	       "\t   (0 for all cores)\n"
+	       "\t-t time budget per number in ms; prime and ecpoint checks report timeout\n"
 	       "\t-X add hex output filter\n"
 	       "\t-D add dec output filter\n"
 	       "\t-B add base64 BIGNUM output filter\n"
@@ -47,26 +96,230 @@ void usage()
 }
 
 
+int import(number::number &num, uint32_t mode, string &n)
+{
+	if (mode & modes::INMODE_HEX) {
+		if (n.find("0x") == 0)
+			n.erase(0, 2);
+		return num.import_hex(n);
+	} else if (mode & modes::INMODE_DEC) {
+		return num.import_dec(n);
+	} else if (mode & modes::INMODE_B64) {
+		return num.import_b64(n, 0);
+	} else if (mode & modes::INMODE_MPI) {
+		return num.import_b64(n, 1);
+	}
+
+	return -1;
+}
+
+
+void close_fd(int *fd)
+{
+	::close(*fd);
+}
+
+
+// make the output durable before recording how far it goes
+int checkpoint(FILE *out, shard_state &st, const string &path)
+{
+	if (fflush(out) != 0 || fsync(fileno(out)) < 0)
+		return -1;
+	off_t off = ftello(out);
+	if (off < 0)
+		return -1;
+	st.out_off = off;
+	return shard_save(path, st);
+}
+
+
+// checkpoint a shard at least this often
+enum { CKPT_RECORDS = 100000, CKPT_SECONDS = 10 };
+
+
+// Classify the lines of f that start before st.end, beginning at st.in_off.
+// With a checkpoint path, the output is synced and the position saved
+// from time to time, so that a killed run resumes where it left off.
+int classify(number::number &num, uint32_t mode, FILE *f, shard_state &st, const string &ckpt)
+{
+	FILE *out = num.output();
+	char *buf = nullptr;
+	size_t blen = 0;
+	ssize_t r = 0;
+	string n = "";
+	uint64_t last = st.records;
+	time_t last_t = time(nullptr);
+	int ret = 0;
+
+	while (st.in_off < st.end && (r = getline(&buf, &blen, f)) > 0) {
+		st.in_off += r;
+		while (r > 0 && (buf[r - 1] == '\n' || buf[r - 1] == '\r'))
+			buf[--r] = 0;
+		if (r == 0 || buf[0] == '#')
+			continue;
+
+		n = buf;
+		fprintf(out, "number: %s\n", buf);
+		if (import(num, mode, n) < 0) {
+			fprintf(out, "error: invalid input\n");
+			++st.invalid;
+		} else
+			num.run_filter("");
+		fprintf(out, "\n");
+		++st.records;
+
+		if (ckpt.size() > 0 && (st.records - last >= CKPT_RECORDS || time(nullptr) - last_t >= CKPT_SECONDS)) {
+			if ((ret = checkpoint(out, st, ckpt)) < 0)
+				break;
+			last = st.records;
+			last_t = time(nullptr);
+		}
+	}
+
+	free(buf);
+	return ret;
+}
+
+
+int batch(number::number &num, uint32_t mode, const string &path)
+{
+	free_ptr<FILE> f(nullptr, number::fclose);
+
+	if (path == "-")
+		f.reset(fdopen(dup(0), "r"));
+	else
+		f.reset(fopen(path.c_str(), "r"));
+	if (!f.get())
+		return -1;
+
+	shard_state st;
+	return classify(num, mode, f.get(), st, "");
+}
+
+
+// batch() on worker threads, each with its own number set up like num
+int batch_workers(number::number &num, uint32_t mode, const string &path, unsigned int nw)
+{
+	int fd = 0;
+	if (path != "-" && (fd = open(path.c_str(), O_RDONLY|O_CLOEXEC)) < 0)
+		return -1;
+	free_ptr<int> in(&fd, path != "-" ? close_fd : [](int *) {});
+
+	vector<unique_ptr<number::number>> nums;
+	vector<number::number *> workers;
+	for (unsigned int i = 0; i < nw; ++i) {
+		nums.push_back(unique_ptr<number::number>(new (nothrow) number::number));
+		if (!nums.back().get())
+			return -1;
+		nums.back()->copy_config(num);
+		workers.push_back(nums.back().get());
+	}
+
+	fflush(stdout);
+	int r = pipeline(fd, 1, workers, [mode](number::number &wn, string &s) { return import(wn, mode, s); });
+
+	for (auto i = nums.begin(); i != nums.end(); ++i)
+		num.add_stats(**i);
+	return r;
+}
+
+
+// Run shard k of n, or all unclaimed and unfinished shards if k < 0.
+// Output of shard k goes to base.k, resuming from base.k.ckpt if there is one.
+int shards(number::number &num, uint32_t mode, const string &path, int k, unsigned int n, const string &base)
+{
+	unsigned int first = (k < 0) ? 0 : k, last = (k < 0) ? n : k + 1;
+	int ran = 0;
+
+	for (unsigned int i = first; i < last; ++i) {
+		int lock = shard_claim(shard_path(base, i, ".lock"));
+		if (lock < 0) {
+			fprintf(stderr, "number: shard %u/%u is taken\n", i, n);
+			continue;
+		}
+		free_ptr<int> claim(&lock, close_fd);
+
+		shard_state st;
+		string ckpt = shard_path(base, i, ".ckpt");
+		if (shard_load(ckpt, st) < 0 || st.k != i || st.n != n) {
+			if (shard_range(path, i, n, st) < 0)
+				return -1;
+		}
+		if (st.done)
+			continue;
+
+		free_ptr<FILE> in(fopen(path.c_str(), "r"), number::fclose);
+		if (!in.get() || fseeko(in.get(), st.in_off, SEEK_SET) < 0)
+			return -1;
+
+		// drop output that the checkpoint does not know of
+		string opath = shard_path(base, i);
+		int fd = open(opath.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+		if (fd < 0 || ftruncate(fd, st.out_off) < 0 || lseek(fd, st.out_off, SEEK_SET) < 0) {
+			if (fd >= 0)
+				close(fd);
+			return -1;
+		}
+		free_ptr<FILE> out(fdopen(fd, "w"), number::fclose);
+		if (!out.get()) {
+			close(fd);
+			return -1;
+		}
+
+		FILE *of = num.output();
+		num.output(out.get());
+		int r = classify(num, mode, in.get(), st, ckpt);
+		num.output(of);
+		if (r < 0 || ferror(in.get()))
+			return -1;
+
+		st.done = 1;
+		if (checkpoint(out.get(), st, ckpt) < 0)
+			return -1;
+		fprintf(stderr, "shard %u/%u: %llu numbers, %llu invalid\n", i, n,
+		        (unsigned long long)st.records, (unsigned long long)st.invalid);
+		++ran;
+	}
+
+	return ran;
+}
+
+
+int scan(const string &path, unsigned int threads)
+{
+	context ctx;
+	scanner sc;
+	vector<scan_hit> hits;
+
+	init_tables(ctx);
+	if (sc.build(ctx) < 0) {
+		fprintf(stderr, "number: no known numbers to scan for\n");
+		return -1;
+	}
+
+	if (sc.scan(path, threads, hits) < 0) {
+		fprintf(stderr, "number: cannot scan %s\n", path.c_str());
+		return -1;
+	}
+
+	for (auto i = hits.begin(); i != hits.end(); ++i)
+		printf("0x%08zx: %s\n", i->offset, sc.label(*i).c_str());
+
+	return 0;
+}
+
+
 int main(int argc, char **argv)
 {
 	number::number num;
-	enum modes : uint32_t {
-		MODE_INVALID	= 0,
-		INMODE_HEX	= 1,
-		INMODE_DEC	= 2,
-		INMODE_B64	= 4,
-		INMODE_MPI	= 8,
-		OUTMODE_HEX	= 0x1000,
-		OUTMODE_DEC	= 0x2000,
-		OUTMODE_B64	= 0x4000,
-		OUTMODE_MPI	= 0x8000,
-		OUTMODE_LE	= 0x10000
-	};
 	uint32_t mode = modes::MODE_INVALID;
 	int c;
-	string n = "", filter = "";
+	size_t cache_size = 65536;
+	unsigned int threads = 1, nshards = 0, workers = 0;
+	int shard = -1;
+	string n = "", filter = "", cache_file = "", base = "";
 
-	while ((c = getopt(argc, argv, "x:d:b:m:XDBML")) != -1) {
+	while ((c = getopt(argc, argv, "x:d:b:m:f:i:c:C:T:t:w:s:S:O:J:XDBML")) != -1) {
 		switch (c) {
 		case 'x':
 			n = optarg;
@@ -84,6 +337,66 @@ int main(int argc, char **argv)
 			n = optarg;
 			mode |= modes::INMODE_MPI;
 			break;
+		case 'f':
+			n = optarg;
+			mode |= modes::MODE_BATCH;
+			break;
+		case 'i':
+			mode &= ~(modes::INMODE_HEX|modes::INMODE_DEC|modes::INMODE_B64|modes::INMODE_MPI);
+			if (optarg[0] == 'x')
+				mode |= modes::INMODE_HEX;
+			else if (optarg[0] == 'd')
+				mode |= modes::INMODE_DEC;
+			else if (optarg[0] == 'b')
+				mode |= modes::INMODE_B64;
+			else if (optarg[0] == 'm')
+				mode |= modes::INMODE_MPI;
+			else
+				usage();
+			break;
+		case 'c':
+			cache_size = strtoul(optarg, nullptr, 10);
+			break;
+		case 'C':
+			cache_file = optarg;
+			break;
+		case 's':
+			n = optarg;
+			mode |= modes::MODE_SCAN;
+			break;
+		case 'S':
+			if (strchr(optarg, '/')) {
+				shard = strtoul(optarg, nullptr, 10);
+				nshards = strtoul(strchr(optarg, '/') + 1, nullptr, 10);
+			} else
+				nshards = strtoul(optarg, nullptr, 10);
+			if (nshards == 0 || shard >= (int)nshards)
+				usage();
+			mode |= modes::MODE_SHARD;
+			break;
+		case 'O':
+			base = optarg;
+			break;
+		case 'J':
+			nshards = strtoul(optarg, nullptr, 10);
+			mode |= modes::MODE_MERGE;
+			break;
+		case 'T':
+			threads = strtoul(optarg, nullptr, 10);
+			if (threads == 0)
+				threads = thread::hardware_concurrency();
+			num.prime_threads(threads);
+			break;
+		case 't':
+			num.time_budget(strtoul(optarg, nullptr, 10));
+			break;
+		case 'w':
+			workers = strtoul(optarg, nullptr, 10);
+			if (workers == 0)
+				workers = thread::hardware_concurrency();
+			if (workers == 0)
+				workers = 1;
+			break;
 		case 'X':
 			mode |= modes::OUTMODE_HEX;
 			break;
@@ -104,31 +417,87 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (mode & modes::MODE_SCAN)
+		return scan(n, threads) < 0 ? 1 : 0;
 
-	if (mode & modes::INMODE_HEX) {
-		if (n.find("0x") == 0)
-			n.erase(0, 2);
-		num.import_hex(n);
-	} else if (mode & modes::INMODE_DEC) {
-		num.import_dec(n);
-	} else if (mode & modes::INMODE_B64) {
-		num.import_b64(n, 0);
-	} else if (mode & modes::INMODE_MPI) {
-		num.import_b64(n, 1);
+	if (mode & modes::MODE_MERGE) {
+		shard_state total;
+		if (base.size() == 0 || nshards == 0)
+			usage();
+		if (shard_merge(base, nshards, stdout, total) < 0) {
+			fprintf(stderr, "number: cannot merge, not all of %u shards of %s are finished\n", nshards, base.c_str());
+			return 1;
+		}
+		fprintf(stderr, "merge: %u shards, %llu numbers, %llu invalid\n", nshards,
+		        (unsigned long long)total.records, (unsigned long long)total.invalid);
+		return 0;
 	}
 
+	if ((mode & modes::MODE_SHARD) && (!(mode & modes::MODE_BATCH) || n == "-" || base.size() == 0))
+		usage();
+
+	if ((mode & modes::MODE_BATCH) &&
+	    !(mode & (modes::INMODE_HEX|modes::INMODE_DEC|modes::INMODE_B64|modes::INMODE_MPI)))
+		mode |= modes::INMODE_HEX;
+
 	if (mode & modes::OUTMODE_HEX)
-		num.add_filter("hex", filter_hex);
+		num.enable_filter(FILTER_HEX);
 	if (mode & modes::OUTMODE_DEC)
-		num.add_filter("dec", filter_dec);
+		num.enable_filter(FILTER_DEC);
 	if (mode & modes::OUTMODE_B64)
-		num.add_filter("base64", filter_b64);
+		num.enable_filter(FILTER_B64);
 	if (mode & modes::OUTMODE_MPI)
-		num.add_filter("mpi", filter_mpi);
+		num.enable_filter(FILTER_MPI);
 	if (mode & modes::OUTMODE_LE)
-		num.add_filter("le", filter_le);
+		num.enable_filter(FILTER_LE);
+
+	unique_ptr<result_cache> cache(nullptr);
+	if (((mode & modes::MODE_BATCH) && cache_size > 0) || cache_file.size() > 0) {
+		cache.reset(new (nothrow) result_cache(cache_size > 0 ? cache_size : 65536));
+		if (!cache.get())
+			return 1;
+		if (cache_file.size() > 0)
+			cache->load(cache_file, num.fingerprint());
+		num.use_cache(cache.get());
+	}
+
+	if (mode & modes::MODE_SHARD) {
+		if (shards(num, mode, n, shard, nshards, base) < 0) {
+			fprintf(stderr, "number: cannot run shards of %s to %s\n", n.c_str(), base.c_str());
+			return 1;
+		}
+	} else if ((mode & modes::MODE_BATCH) && workers > 0) {
+		if (batch_workers(num, mode, n, workers) < 0) {
+			fprintf(stderr, "number: cannot classify %s\n", n.c_str());
+			return 1;
+		}
+	} else if (mode & modes::MODE_BATCH) {
+		if (batch(num, mode, n) < 0) {
+			fprintf(stderr, "number: cannot open %s\n", n.c_str());
+			return 1;
+		}
+	} else {
+		import(num, mode, n);
+		num.run_filter(filter);
+	}
+
+	if (cache.get()) {
+		if (cache_file.size() > 0 && cache->save(cache_file, num.fingerprint()) < 0)
+			fprintf(stderr, "number: cannot save cache to %s\n", cache_file.c_str());
+
+		uint64_t lookups = cache->hits() + cache->misses();
+		if (mode & modes::MODE_BATCH)
+			fprintf(stderr, "cache: %zu entries, %llu hits, %llu misses, %llu evictions, %.2f%% hit rate\n",
+			        cache->size(), (unsigned long long)cache->hits(), (unsigned long long)cache->misses(),
+			        (unsigned long long)cache->evictions(), lookups ? 100.0 * cache->hits() / lookups : 0.0);
+	}
+
+	if (mode & modes::MODE_BATCH) {
+		string stats = "";
+		num.latency_stats(stats);
+		fprintf(stderr, "%s", stats.c_str());
+	}
 
-	num.run_filter(filter);
 	return 0;
 }
 
@@ -0,0 +1,41 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef number_misc_h
+#define number_misc_h
+
+#include <cstdio>
+#include <memory>
+
+namespace number {
+
+// unique_ptr helper type
+template<class T> using free_ptr = std::unique_ptr<T, void (*)(T *)>;
+
+// helper function to remove int return
+inline void fclose(FILE *f)
+{
+	::fclose(f);
+}
+
+}
+
+#endif
+
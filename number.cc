@@ -18,10 +18,13 @@
  * along with number.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdio>
 #include <string>
 #include <map>
+#include <chrono>
 #include <functional>
 #include "base64.h"
+#include "digest.h"
 #include "number.h"
 
 extern "C" {
@@ -35,31 +38,185 @@ using namespace std;
 namespace number {
 
 
-int number::add_filter(const string &name, const function<int(BIGNUM *)> &f)
+int number::add_filter(const string &name, const function<int(BIGNUM *, context &, string &)> &f)
 {
-	d_filter.emplace(make_pair(name, f));
+	d_plugins.push_back(make_pair(name, f));
+	d_plugin_lat.push_back(latency_hist());
+	return 0;
+}
+
+
+static inline void emit(const string &r, string *os, FILE *of)
+{
+	if (os)
+		os->append(r);
+	else
+		fputs(r.c_str(), of);
+}
+
+
+// runs f and records how long it took
+template<typename F>
+static inline int run_timed(F &&f, latency_hist &lat, context &ctx, string &r)
+{
+	// only the long running filters look at the deadline, the cheap ones
+	// always run so an expensive primality test does not hide their result
+	ctx.timed_out = 0;
+	auto start = chrono::steady_clock::now();
+	int ret = f(r);
+	lat.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	if (ctx.timed_out)
+		lat.timeout();
+	return ret;
+}
+
+
+template<typename F>
+static inline int run_cached(const string &name, F &&f, results_t &cached, bool use_cache, bool &dirty, context &ctx, string &r, string *os, FILE *of)
+{
+	if (use_cache) {
+		auto c = cached.find(name);
+		if (c != cached.end()) {
+			emit(c->second, os, of);
+			return 0;
+		}
+	}
+
+	r.clear();
+	if (f(r) < 0)
+		return -1;
+	emit(r, os, of);
+	if (use_cache && !ctx.timed_out) {
+		cached[name] = r;
+		dirty = 1;
+	}
 	return 0;
 }
 
 
 int number::run_filter(const string &name)
 {
+	string &r = d_out;
+
+	d_ctx.deadline(d_budget);
+
 	if (name.size() == 0) {
-		for (auto i = d_filter.begin(); i != d_filter.end(); ++i)
-			i->second(d_bn);
+		if (!d_bn)
+			return -1;
+
+		results_t cached;
+		string key = "";
+		bool dirty = 0, use_cache = (d_cache != nullptr);
+
+		if (use_cache) {
+			// leading sign byte, so that 7 and -7 do not share an entry
+			key.resize(BN_num_bytes(d_bn) + 1);
+			key[0] = BN_is_negative(d_bn) ? '-' : '+';
+			BN_bn2bin(d_bn, reinterpret_cast<unsigned char *>(&key[1]));
+			d_cache->find(key, cached);
+		}
+
+		auto builtin = [&](const filter_desc &fd) {
+			latency_hist &lat = d_lat[&fd - filter_table];
+			auto f = [&](string &out) { return fd.fn(d_bn, d_ctx, out); };
+			if (!use_cache) {
+				r.clear();
+				if (run_timed(f, lat, d_ctx, r) == 0)
+					emit(r, d_os, d_of);
+				return;
+			}
+			run_cached(fd.name, [&](string &out) { return run_timed(f, lat, d_ctx, out); }, cached, use_cache, dirty, d_ctx, r, d_os, d_of);
+		};
+		filter_dispatch<0>::each(d_mask, builtin);
+
+		for (size_t i = 0; i < d_plugins.size(); ++i) {
+			auto f = [&](string &out) { return d_plugins[i].second(d_bn, d_ctx, out); };
+			run_cached(d_plugins[i].first, [&](string &out) { return run_timed(f, d_plugin_lat[i], d_ctx, out); },
+			           cached, use_cache, dirty, d_ctx, r, d_os, d_of);
+		}
+
+		if (dirty)
+			d_cache->insert(key, cached);
 		return 0;
 	}
 
-	auto it = d_filter.find(name);
-	if (it == d_filter.end())
-		return -1;
+	r.clear();
+	for (size_t i = 0; i < filter_count; ++i) {
+		if (name == filter_table[i].name) {
+			int ret = run_timed([&](string &out) { return filter_table[i].fn(d_bn, d_ctx, out); }, d_lat[i], d_ctx, r);
+			emit(r, d_os, d_of);
+			return ret;
+		}
+	}
 
-	return it->second(d_bn);
+	for (size_t i = 0; i < d_plugins.size(); ++i) {
+		if (d_plugins[i].first == name) {
+			int ret = run_timed([&](string &out) { return d_plugins[i].second(d_bn, d_ctx, out); }, d_plugin_lat[i], d_ctx, r);
+			emit(r, d_os, d_of);
+			return ret;
+		}
+	}
+
+	return -1;
+}
+
+
+static void latency_line(const char *name, const latency_hist &lat, string &r)
+{
+	if (lat.count() == 0 && lat.timeouts() == 0)
+		return;
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "latency: %s %llu runs, p50 %.1fus, p99 %.1fus, p999 %.1fus, max %.1fus, %llu timeouts\n",
+	         name, (unsigned long long)lat.count(), lat.percentile(0.5)/1000.0, lat.percentile(0.99)/1000.0,
+	         lat.percentile(0.999)/1000.0, lat.max()/1000.0, (unsigned long long)lat.timeouts());
+	r += buf;
+}
+
+
+uint64_t number::fingerprint() const
+{
+	string s = to_string(d_mask) + "\n" + to_string(tables_fingerprint()) + "\n";
+	for (auto i = d_plugins.begin(); i != d_plugins.end(); ++i)
+		s += i->first + "\n";
+	return digest64(s);
+}
+
+
+void number::copy_config(const number &o)
+{
+	d_cache = o.d_cache;
+	d_mask = o.d_mask;
+	d_plugins = o.d_plugins;
+	d_plugin_lat.assign(d_plugins.size(), latency_hist());
+	d_budget = o.d_budget;
+	d_ctx.prime_threads = o.d_ctx.prime_threads;
+	d_ctx.prime_min_bits = o.d_ctx.prime_min_bits;
+}
+
+
+void number::add_stats(const number &o)
+{
+	for (size_t i = 0; i < filter_count; ++i)
+		d_lat[i].merge(o.d_lat[i]);
+	for (size_t i = 0; i < d_plugin_lat.size() && i < o.d_plugin_lat.size(); ++i)
+		d_plugin_lat[i].merge(o.d_plugin_lat[i]);
+}
+
+
+void number::latency_stats(string &r) const
+{
+	for (size_t i = 0; i < filter_count; ++i)
+		latency_line(filter_table[i].name, d_lat[i], r);
+	for (size_t i = 0; i < d_plugins.size(); ++i)
+		latency_line(d_plugins[i].first.c_str(), d_plugin_lat[i], r);
 }
 
 
 int number::import_hex(const string &s)
 {
+	d_ctx.canon_valid = 0;
+
 	if (BN_hex2bn(&d_bn, s.c_str()) == 0)
 		return -1;
 
@@ -69,6 +226,8 @@ int number::import_hex(const string &s)
 
 int number::import_dec(const string &s)
 {
+	d_ctx.canon_valid = 0;
+
 	if (BN_dec2bn(&d_bn, s.c_str()) == 0)
 		return -1;
 
@@ -78,6 +237,8 @@ int number::import_dec(const string &s)
 
 int number::import_b64(const string &b64, bool mpi)
 {
+	d_ctx.canon_valid = 0;
+
 	string s = "";
 	if (b64_decode(b64, s).size() == 0)
 		return -1;
@@ -87,8 +248,11 @@ int number::import_b64(const string &b64, bool mpi)
 	if (mpi)
 		f = BN_mpi2bn;
 
-	if (!(d_bn = f(reinterpret_cast<const unsigned char *>(s.c_str()), s.size(), nullptr)))
-			return -1;
+	// re-use d_bn when importing many numbers in a row
+	BIGNUM *bn = f(reinterpret_cast<const unsigned char *>(s.c_str()), s.size(), d_bn);
+	if (!bn)
+		return -1;
+	d_bn = bn;
 
 	return 0;
 }
@@ -22,9 +22,15 @@
 #define number_number_h
 
 #include <cstdio>
-#include <unordered_map>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
 #include <functional>
 #include "filters.h"
+#include "cache.h"
+#include "context.h"
+#include "latency.h"
 
 
 extern "C" {
@@ -39,14 +45,29 @@ class number {
 
 	BIGNUM *d_bn{nullptr};
 
-	std::unordered_map<std::string, std::function<int(BIGNUM *)>> d_filter{
-		{"bits", filter_bits},
-		{"bytes", filter_bytes},
-		{"prime", filter_prime},
-		{"ecpoint", filter_ecpoint},
-		{"hash", filter_hash},
-		{"match", filter_match}
-	};
+	context d_ctx;
+
+	// filter output, re-used across numbers
+	std::string d_out{""};
+
+	// where run_filter() writes the output to; appended to d_os if set
+	FILE *d_of{stdout};
+	std::string *d_os{nullptr};
+
+	result_cache *d_cache{nullptr};
+
+	// built-in filters from filter_table enabled for this number
+	uint32_t d_mask{FILTER_DEFAULT};
+
+	// runtime added filters, run after the built-ins
+	std::vector<std::pair<std::string, std::function<int(BIGNUM *, context &, std::string &)>>> d_plugins;
+
+	// time budget per number in ms, 0 for none
+	unsigned int d_budget{0};
+
+	// per filter latency, indexed like filter_table and d_plugins
+	latency_hist d_lat[filter_count];
+	std::vector<latency_hist> d_plugin_lat;
 
 public:
 
@@ -68,10 +89,70 @@ public:
 
 	int import_b64(const std::string &, bool mpi = 0);
 
-	int add_filter(const std::string &, const std::function<int(BIGNUM*)> &);
+	int add_filter(const std::string &, const std::function<int(BIGNUM*, context &, std::string &)> &);
+
+	// enable built-in filters by FILTER_* mask
+	void enable_filter(uint32_t mask)
+	{
+		d_mask |= mask;
+	}
+
+	void disable_filter(uint32_t mask)
+	{
+		d_mask &= ~mask;
+	}
+
+	// run primality tests of numbers with at least min_bits on n threads
+	void prime_threads(unsigned int n, int min_bits = 4096)
+	{
+		d_ctx.prime_threads = n;
+		d_ctx.prime_min_bits = min_bits;
+	}
+
+	// results of the full filter set are looked up in / stored to the cache
+	void use_cache(result_cache *c)
+	{
+		d_cache = c;
+	}
+
+	void output(FILE *f)
+	{
+		d_of = f;
+		d_os = nullptr;
+	}
+
+	void output(std::string *s)
+	{
+		d_os = s;
+	}
+
+	FILE *output() const
+	{
+		return d_of;
+	}
+
+	// the primality test and the curve point checks give up when the budget
+	// of a number is used up, report "timeout" and are not cached
+	void time_budget(unsigned int ms)
+	{
+		d_budget = ms;
+	}
 
 	int run_filter(const std::string &);
 
+	// identifies the enabled filters and the tables behind them, to tell
+	// whether persisted results still apply
+	uint64_t fingerprint() const;
+
+	// take over filters, plugins, budget and cache of o, e.g. for worker threads
+	void copy_config(const number &o);
+
+	// add the latency stats of o to ours
+	void add_stats(const number &o);
+
+	// one "latency: name runs p50 p99 p999 max timeouts" line per filter that ran
+	void latency_stats(std::string &) const;
+
 };
 
 }
@@ -0,0 +1,378 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include "aio.h"
+#include "spsc.h"
+#include "number.h"
+#include "pipeline.h"
+
+
+using namespace std;
+
+
+namespace number {
+
+
+namespace {
+
+enum {
+	BLOCK	= 1<<20,	// bytes per read/write
+	READS	= 4,		// in flight, for seekable input
+	WRITES	= 4,		// in flight, for seekable output
+	RING	= 1024,		// records per SPSC ring
+	DONE	= 16		// completions per reap
+};
+
+// a line on the way to a worker, or its output on the way back
+struct record {
+	uint64_t seq{0};
+	std::string data{""};
+	bool eof{0};
+};
+
+struct worker_io {
+	spsc_ring<record> in{RING}, out{RING};
+};
+
+const uint64_t WRITE_TAG = uint64_t(1)<<63;
+
+}
+
+
+// spin a little, then sleep; there may be fewer cores than threads
+static void backoff(unsigned int &spins)
+{
+	if (++spins < 64)
+		this_thread::yield();
+	else
+		this_thread::sleep_for(chrono::microseconds(100));
+}
+
+
+static void worker(number *num, worker_io *io, const function<int(number &, string &)> *import)
+{
+	record rec;
+	string n = "", out = "";
+	unsigned int spins = 0;
+
+	num->output(&out);
+
+	for (;;) {
+		if (!io->in.pop(rec)) {
+			backoff(spins);
+			continue;
+		}
+		spins = 0;
+		if (rec.eof)
+			break;
+
+		out.clear();
+		out += "number: ";
+		out += rec.data;
+		out += "\n";
+		n = rec.data;
+		if ((*import)(*num, n) < 0)
+			out += "error: invalid input\n";
+		else
+			num->run_filter("");
+		out += "\n";
+
+		swap(rec.data, out);
+		while (!io->out.push(rec))
+			backoff(spins);
+		spins = 0;
+	}
+
+	num->output(stdout);
+}
+
+
+// offsets only mean something for files that are not opened for appending
+static bool seekable(int fd)
+{
+	int fl = fcntl(fd, F_GETFL);
+	return fl >= 0 && !(fl & O_APPEND) && lseek(fd, 0, SEEK_CUR) >= 0;
+}
+
+
+int pipeline(int in, int out, vector<number *> &workers, const function<int(number &, string &)> &import, bool uring)
+{
+	size_t nw = workers.size();
+	if (nw == 0)
+		return -1;
+
+	async_io aio;
+	if (aio.init(READS + WRITES, uring) < 0)
+		return -1;
+
+	bool in_seek = seekable(in), out_seek = seekable(out);
+	off_t in_base = in_seek ? lseek(in, 0, SEEK_CUR) : 0, out_off = out_seek ? lseek(out, 0, SEEK_CUR) : 0;
+
+	// reads: block i goes to slot i % rdepth; state 0 idle, 1 in flight, 2 ready
+	unsigned int rdepth = in_seek ? READS : 1;
+	vector<unique_ptr<char[]>> rbuf(rdepth);
+	vector<size_t> rfill(rdepth, 0);
+	vector<int> rstate(rdepth, 0);
+	vector<bool> reof(rdepth, 0);
+	uint64_t rissue = 0, rparse = 0;
+	size_t rpos = 0;
+	bool in_eof = 0, in_done = 0;
+
+	// writes, in order of queueing; for non-seekable output one at a time
+	unsigned int wdepth = out_seek ? WRITES : 1;
+	vector<string> wbuf(wdepth);
+	vector<size_t> wdone(wdepth, 0);
+	vector<off_t> woff(wdepth, 0);
+	vector<bool> wbusy(wdepth, 0);
+	string pend = "";
+
+	vector<unique_ptr<worker_io>> io;
+	vector<thread> threads;
+	record rec, orec;
+	bool rec_pending = 0, fail = 0;
+	uint64_t seq = 0, written = 0;
+	string line = "";
+	aio_op done[DONE];
+	unsigned int spins = 0;
+
+	try {
+		for (unsigned int i = 0; i < rdepth; ++i)
+			rbuf[i].reset(new char[BLOCK]);
+		pend.reserve(BLOCK);
+		for (size_t i = 0; i < nw; ++i)
+			io.push_back(unique_ptr<worker_io>(new worker_io));
+		for (size_t i = 0; i < nw; ++i)
+			threads.push_back(thread(worker, workers[i], io[i].get(), &import));
+	} catch (...) {
+		fail = 1;
+	}
+
+	// hand out the current line, false if the workers ring is full
+	auto emit = [&]() -> bool {
+		while (line.size() > 0 && line[line.size() - 1] == '\r')
+			line.erase(line.size() - 1);
+		if (line.size() == 0 || line[0] == '#') {
+			line.clear();
+			return true;
+		}
+		rec.seq = seq;
+		rec.eof = 0;
+		swap(rec.data, line);
+		line.clear();
+		rec_pending = !io[seq % nw]->in.push(rec);
+		++seq;
+		return !rec_pending;
+	};
+
+	bool block = 0;
+	while (!fail) {
+		int nd = aio.complete(done, DONE, block);
+		if (nd < 0) {
+			fail = 1;
+			break;
+		}
+		bool progress = (nd > 0);
+
+		for (int i = 0; i < nd && !fail; ++i) {
+			aio_op &op = done[i];
+			if (op.res < 0) {
+				if (op.res == -EINTR || op.res == -EAGAIN) {
+					fail = (aio.queue(op) < 0);
+					continue;
+				}
+				fail = 1;
+				break;
+			}
+
+			if (op.tag & WRITE_TAG) {
+				unsigned int s = op.tag & ~WRITE_TAG;
+				wdone[s] += op.res;
+				if (op.res == 0)
+					fail = 1;
+				else if (wdone[s] < wbuf[s].size()) {
+					op.buf = &wbuf[s][wdone[s]];
+					op.len = wbuf[s].size() - wdone[s];
+					op.off = out_seek ? woff[s] + wdone[s] : -1;
+					fail = (aio.queue(op) < 0);
+				} else
+					wbusy[s] = 0;
+				continue;
+			}
+
+			unsigned int s = op.tag % rdepth;
+			rfill[s] += op.res;
+			if (op.res == 0) {
+				reof[s] = 1;
+				in_eof = 1;
+				rstate[s] = 2;
+			} else if (in_seek && rfill[s] < BLOCK) {
+				// short read before the end; get the rest
+				op.buf = rbuf[s].get() + rfill[s];
+				op.len = BLOCK - rfill[s];
+				op.off = in_base + op.tag*BLOCK + rfill[s];
+				fail = (aio.queue(op) < 0);
+			} else
+				rstate[s] = 2;
+		}
+		if (fail)
+			break;
+
+		// keep the reads ahead of the parser
+		while (!in_eof && rissue - rparse < rdepth) {
+			unsigned int s = rissue % rdepth;
+			aio_op op;
+			op.fd = in;
+			op.buf = rbuf[s].get();
+			op.len = BLOCK;
+			op.off = in_seek ? in_base + rissue*BLOCK : -1;
+			op.tag = rissue;
+			if (aio.queue(op) < 0)
+				break;
+			rfill[s] = 0;
+			rstate[s] = 1;
+			reof[s] = 0;
+			++rissue;
+			progress = 1;
+		}
+
+		if (rec_pending && io[rec.seq % nw]->in.push(rec)) {
+			rec_pending = 0;
+			progress = 1;
+		}
+
+		// cut ready blocks into lines
+		while (!in_done && !rec_pending && rstate[rparse % rdepth] == 2) {
+			unsigned int s = rparse % rdepth;
+			const char *b = rbuf[s].get();
+			while (rpos < rfill[s] && !rec_pending) {
+				const char *nl = static_cast<const char *>(memchr(b + rpos, '\n', rfill[s] - rpos));
+				size_t end = nl ? nl - b : rfill[s];
+				line.append(b + rpos, end - rpos);
+				rpos = end;
+				if (nl) {
+					++rpos;
+					emit();
+				}
+			}
+			progress = 1;
+			if (rec_pending)
+				break;
+
+			if (reof[s]) {
+				emit();
+				in_done = 1;
+			} else {
+				rstate[s] = 0;
+				rpos = 0;
+				++rparse;
+			}
+		}
+
+		// collect output in input order
+		while (written < seq && io[written % nw]->out.pop(orec)) {
+			pend += orec.data;
+			++written;
+			progress = 1;
+		}
+
+		bool all_out = in_done && !rec_pending && written == seq;
+
+		if (pend.size() >= BLOCK || (all_out && pend.size() > 0)) {
+			for (unsigned int s = 0; s < wdepth; ++s) {
+				if (wbusy[s])
+					continue;
+				swap(wbuf[s], pend);
+				pend.clear();
+				aio_op op;
+				op.fd = out;
+				op.buf = &wbuf[s][0];
+				op.len = wbuf[s].size();
+				op.off = out_seek ? out_off : -1;
+				op.write = 1;
+				op.tag = WRITE_TAG | s;
+				if (aio.queue(op) < 0) {
+					swap(wbuf[s], pend);
+					break;
+				}
+				wbusy[s] = 1;
+				wdone[s] = 0;
+				woff[s] = out_off;
+				out_off += op.len;
+				progress = 1;
+				break;
+			}
+		}
+
+		if (all_out && pend.size() == 0 && aio.busy() == 0)
+			break;
+
+		// nothing to do until I/O finishes or a worker is done
+		block = 0;
+		if (progress)
+			spins = 0;
+		else if (aio.busy() > 0 && written == seq)
+			block = 1;
+		else
+			backoff(spins);
+	}
+
+	// stop the workers; after a failure their output rings may still be full
+	vector<bool> told(threads.size(), 0);
+	for (size_t left = threads.size(); left > 0;) {
+		for (size_t i = 0; i < threads.size(); ++i) {
+			while (io[i]->out.pop(orec));
+			if (told[i])
+				continue;
+			rec.eof = 1;
+			if (io[i]->in.push(rec)) {
+				told[i] = 1;
+				--left;
+			}
+		}
+		if (left > 0)
+			backoff(spins);
+	}
+	for (auto i = threads.begin(); i != threads.end(); ++i)
+		i->join();
+
+	// buffers must outlive the I/O that still uses them
+	while (aio.busy() > 0 && aio.complete(done, DONE, 1) >= 0);
+
+	if (out_seek && !fail)
+		lseek(out, out_off, SEEK_SET);
+
+	return fail ? -1 : 0;
+}
+
+
+}
+
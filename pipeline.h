@@ -0,0 +1,47 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_pipeline_h
+#define number_pipeline_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include "number.h"
+
+
+namespace number {
+
+
+// Batch mode on worker threads. The calling thread keeps several large
+// reads of in and writes to out in flight (io_uring, or epoll/pread), cuts
+// the input into lines and hands them round robin to the workers through
+// one SPSC ring each. Every worker classifies with its own number object and
+// returns the output through another SPSC ring, from which the calling
+// thread collects it in input order. uring == 0 forces the fallback.
+int pipeline(int in, int out, std::vector<number *> &workers,
+             const std::function<int(number &, std::string &)> &import, bool uring = 1);
+
+}
+
+#endif
+
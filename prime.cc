@@ -0,0 +1,367 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include "misc.h"
+#include "prime.h"
+
+extern "C" {
+#include <openssl/bn.h>
+}
+
+
+namespace number {
+
+using namespace std;
+
+
+static const vector<unsigned int> &small_primes()
+{
+	static const vector<unsigned int> primes = []() {
+		vector<unsigned int> v;
+		vector<bool> sieve(4096, 1);
+		for (unsigned int i = 2; i < sieve.size(); ++i) {
+			if (!sieve[i])
+				continue;
+			v.push_back(i);
+			for (unsigned int j = i*i; j < sieve.size(); j += i)
+				sieve[j] = 0;
+		}
+		return v;
+	}();
+
+	return primes;
+}
+
+
+namespace {
+
+// read-only after setup, shared by all workers
+struct prime_job {
+	const BIGNUM *n{nullptr}, *n1{nullptr}, *d{nullptr};
+	int s{0};
+	int jobs{0};
+	BN_GENCB *cb{nullptr};
+	atomic<int> next{0};
+	atomic<bool> stop{false}, composite{false}, error{false};
+};
+
+}
+
+
+// one MR round; base == nullptr picks a random witness in [2, n - 2]
+static int mr_round(prime_job &job, const BIGNUM *base, BN_CTX *ctx, BN_MONT_CTX *mont)
+{
+	BN_CTX_start(ctx);
+	BIGNUM *a = BN_CTX_get(ctx), *x = BN_CTX_get(ctx), *range = BN_CTX_get(ctx);
+	int r = -1;
+
+	if (!range)
+		goto out;
+
+	if (base) {
+		if (!BN_copy(a, base))
+			goto out;
+	} else {
+		if (!BN_sub(range, job.n, BN_value_one()) || !BN_sub_word(range, 2) ||
+		    !BN_rand_range(a, range) || !BN_add_word(a, 2))
+			goto out;
+	}
+
+	if (!BN_mod_exp_mont(x, a, job.d, job.n, ctx, mont))
+		goto out;
+
+	if (BN_is_one(x) || BN_cmp(x, job.n1) == 0) {
+		r = 1;
+		goto out;
+	}
+
+	for (int i = 1; i < job.s; ++i) {
+		if (job.stop) {
+			r = 1;
+			goto out;
+		}
+		if (!BN_mod_sqr(x, x, job.n, ctx))
+			goto out;
+		if (BN_cmp(x, job.n1) == 0) {
+			r = 1;
+			goto out;
+		}
+		if (BN_is_one(x))
+			break;
+	}
+
+	r = 0;
+
+out:
+	BN_CTX_end(ctx);
+	return r;
+}
+
+
+// x = x/2 mod n, n odd
+static int mod_half(BIGNUM *x, const BIGNUM *n)
+{
+	if (BN_is_odd(x) && !BN_add(x, x, n))
+		return 0;
+	return BN_rshift1(x, x);
+}
+
+
+// floor(sqrt(n))^2 == n, by Newton iteration
+static int is_square(const BIGNUM *n, BN_CTX *ctx)
+{
+	BN_CTX_start(ctx);
+	BIGNUM *x = BN_CTX_get(ctx), *y = BN_CTX_get(ctx);
+	int r = -1;
+
+	if (!y || !BN_lshift(x, BN_value_one(), (BN_num_bits(n) + 1)/2 + 1))
+		goto out;
+
+	for (;;) {
+		if (!BN_div(y, nullptr, n, x, ctx) || !BN_add(y, y, x) || !BN_rshift1(y, y))
+			goto out;
+		if (BN_cmp(y, x) >= 0)
+			break;
+		if (!BN_copy(x, y))
+			goto out;
+	}
+
+	if (!BN_sqr(y, x, ctx))
+		goto out;
+	r = (BN_cmp(y, n) == 0);
+
+out:
+	BN_CTX_end(ctx);
+	return r;
+}
+
+
+// strong Lucas probable prime test with Selfridge's parameters (P = 1)
+static int lucas_round(prime_job &job, BN_CTX *ctx)
+{
+	const BIGNUM *n = job.n;
+
+	int sq = is_square(n, ctx);
+	if (sq != 0)
+		return sq < 0 ? -1 : 0;
+
+	BN_CTX_start(ctx);
+	BIGNUM *D = BN_CTX_get(ctx), *Q = BN_CTX_get(ctx), *k = BN_CTX_get(ctx);
+	BIGNUM *U = BN_CTX_get(ctx), *V = BN_CTX_get(ctx), *Qk = BN_CTX_get(ctx);
+	BIGNUM *t1 = BN_CTX_get(ctx), *t2 = BN_CTX_get(ctx);
+	long d = 5, q = 0;
+	int r = -1, s = 0, j = 0;
+
+	if (!t2)
+		goto out;
+
+	// first D in 5, -7, 9, -11, ... with (D/n) == -1
+	for (;; d = (d > 0) ? -(d + 2) : -d + 2) {
+		if (!BN_set_word(D, d > 0 ? d : -d))
+			goto out;
+		BN_set_negative(D, d < 0);
+		if ((j = BN_kronecker(D, n, ctx)) == -2)
+			goto out;
+		if (j == -1)
+			break;
+		// common factor with D; n is larger than any D we try
+		if (j == 0) {
+			r = 0;
+			goto out;
+		}
+	}
+
+	q = (1 - d)/4;
+	if (!BN_set_word(Q, q > 0 ? q : -q))
+		goto out;
+	BN_set_negative(Q, q < 0);
+	if (!BN_nnmod(Q, Q, n, ctx) || !BN_nnmod(D, D, n, ctx))
+		goto out;
+
+	// n + 1 = k * 2^s, k odd
+	if (!BN_add(k, n, BN_value_one()))
+		goto out;
+	for (; !BN_is_bit_set(k, s); ++s);
+	if (!BN_rshift(k, k, s))
+		goto out;
+
+	// U_1 = 1, V_1 = P = 1, Q^1
+	if (!BN_one(U) || !BN_one(V) || !BN_copy(Qk, Q))
+		goto out;
+
+	for (int i = BN_num_bits(k) - 2; i >= 0; --i) {
+		if (job.stop) {
+			r = 1;
+			goto out;
+		}
+
+		// U_2m = U_m V_m, V_2m = V_m^2 - 2Q^m
+		if (!BN_mod_mul(U, U, V, n, ctx) || !BN_mod_sqr(V, V, n, ctx) ||
+		    !BN_mod_lshift1(t1, Qk, n, ctx) || !BN_mod_sub(V, V, t1, n, ctx) ||
+		    !BN_mod_sqr(Qk, Qk, n, ctx))
+			goto out;
+
+		if (!BN_is_bit_set(k, i))
+			continue;
+
+		// U_m+1 = (U_m + V_m)/2, V_m+1 = (D U_m + V_m)/2
+		if (!BN_mod_mul(t1, D, U, n, ctx) || !BN_mod_add(t2, U, V, n, ctx) ||
+		    !mod_half(t2, n) || !BN_mod_add(V, t1, V, n, ctx) || !mod_half(V, n) ||
+		    !BN_copy(U, t2) || !BN_mod_mul(Qk, Qk, Q, n, ctx))
+			goto out;
+	}
+
+	if (BN_is_zero(U)) {
+		r = 1;
+		goto out;
+	}
+
+	// V_k 2^i == 0 for some 0 <= i < s
+	for (int i = 0; i < s; ++i) {
+		if (BN_is_zero(V)) {
+			r = 1;
+			goto out;
+		}
+		if (job.stop) {
+			r = 1;
+			goto out;
+		}
+		if (!BN_mod_sqr(V, V, n, ctx) || !BN_mod_lshift1(t1, Qk, n, ctx) ||
+		    !BN_mod_sub(V, V, t1, n, ctx) || !BN_mod_sqr(Qk, Qk, n, ctx))
+			goto out;
+	}
+
+	r = 0;
+
+out:
+	BN_CTX_end(ctx);
+	return r;
+}
+
+
+static void prime_worker(prime_job *job)
+{
+	free_ptr<BN_CTX> ctx(BN_CTX_new(), BN_CTX_free);
+	free_ptr<BN_MONT_CTX> mont(BN_MONT_CTX_new(), BN_MONT_CTX_free);
+	free_ptr<BIGNUM> two(BN_new(), BN_free);
+
+	if (!ctx.get() || !mont.get() || !two.get() || !BN_set_word(two.get(), 2) ||
+	    !BN_MONT_CTX_set(mont.get(), job->n, ctx.get())) {
+		job->error = true;
+		job->stop = true;
+		return;
+	}
+
+	// job 0 and 1 make up BPSW, the rest are MR rounds with random witnesses
+	int j = 0, r = 0;
+	while (!job->stop && (j = job->next++) < job->jobs) {
+		if (job->cb && BN_GENCB_call(job->cb, 1, j) == 0) {
+			job->error = true;
+			job->stop = true;
+			break;
+		}
+
+		if (j == 0)
+			r = mr_round(*job, two.get(), ctx.get(), mont.get());
+		else if (j == 1)
+			r = lucas_round(*job, ctx.get());
+		else
+			r = mr_round(*job, nullptr, ctx.get(), mont.get());
+
+		if (r == 0)
+			job->composite = true;
+		else if (r < 0)
+			job->error = true;
+		if (r <= 0)
+			job->stop = true;
+	}
+}
+
+
+int is_prime_parallel(const BIGNUM *n, unsigned int threads, int rounds, BN_GENCB *cb)
+{
+	if (!n)
+		return -1;
+	if (BN_is_negative(n) || BN_cmp(n, BN_value_one()) <= 0)
+		return 0;
+
+	const vector<unsigned int> &primes = small_primes();
+
+	// trial division; anything below the square of the largest small prime is decided here
+	for (auto i = primes.begin(); i != primes.end(); ++i) {
+		if (BN_is_word(n, *i))
+			return 1;
+		BN_ULONG m = BN_mod_word(n, *i);
+		if (m == (BN_ULONG)-1)
+			return -1;
+		if (m == 0)
+			return 0;
+	}
+	if (BN_num_bits(n) <= 32 && BN_get_word(n) < primes.back()*primes.back())
+		return 1;
+
+	if (rounds <= 0)
+		rounds = BN_num_bits(n) > 2048 ? 128 : 64;
+	if (threads == 0)
+		threads = 1;
+
+	free_ptr<BIGNUM> n1(BN_dup(n), BN_free), d(BN_new(), BN_free);
+	if (!n1.get() || !d.get() || !BN_sub_word(n1.get(), 1))
+		return -1;
+
+	prime_job job;
+	job.n = n;
+	job.n1 = n1.get();
+	for (job.s = 1; !BN_is_bit_set(n1.get(), job.s); ++job.s);
+	if (!BN_rshift(d.get(), n1.get(), job.s))
+		return -1;
+	job.d = d.get();
+	job.cb = cb;
+
+	// MR base 2 + strong Lucas + rounds - 1 random MR witnesses
+	job.jobs = rounds + 1;
+
+	vector<thread> workers;
+	try {
+		for (unsigned int i = 1; i < threads; ++i)
+			workers.push_back(thread(prime_worker, &job));
+	} catch (...) {
+		// run with what we got
+	}
+	prime_worker(&job);
+
+	for (auto i = workers.begin(); i != workers.end(); ++i)
+		i->join();
+
+	if (job.composite)
+		return 0;
+	if (job.error)
+		return -1;
+	return 1;
+}
+
+
+}
+
@@ -0,0 +1,46 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_prime_h
+#define number_prime_h
+
+extern "C" {
+#include <openssl/bn.h>
+}
+
+
+namespace number {
+
+
+// Probabilistic primality test for big candidates that spreads the
+// Miller-Rabin witnesses and the strong Lucas part of a BPSW test across
+// threads, each with its own BN_CTX and Montgomery context. Remaining
+// rounds are cancelled as soon as one of them proves compositeness.
+// rounds == 0 selects the same number of MR rounds as BN_is_prime_ex().
+// cb, if given, is called as BN_GENCB_call(cb, 1, round) from all workers
+// before each round and cancels the test by returning 0.
+// Returns 1 for probable prime, 0 for composite, -1 on error or cancellation.
+int is_prime_parallel(const BIGNUM *, unsigned int threads, int rounds = 0, BN_GENCB *cb = nullptr);
+
+}
+
+#endif
+
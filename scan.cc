@@ -0,0 +1,205 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "scan.h"
+
+extern "C" {
+#include <openssl/bn.h>
+}
+
+
+namespace number {
+
+using namespace std;
+
+
+static inline uint32_t prefix_hash(uint32_t x)
+{
+	return (x * 0x9e3779b1U) >> (32 - 24);
+}
+
+
+void scanner::add(const string &bin, const string &label)
+{
+	if (bin.size() < PREFIX_LEN)
+		return;
+
+	pattern p;
+	p.bin = bin;
+	p.label = label;
+	d_patterns.push_back(p);
+
+	// dumps of LE machines or LE encodings
+	p.bin.assign(bin.rbegin(), bin.rend());
+	if (p.bin != bin) {
+		p.le = 1;
+		d_patterns.push_back(p);
+	}
+}
+
+
+int scanner::build(const context &ctx)
+{
+	d_patterns.clear();
+
+	const vector<catalog::entry> &entries = ctx.cat.entries();
+	for (auto i = entries.begin(); i != entries.end(); ++i)
+		add(i->bin, i->label);
+
+	// drop duplicates such as the SHA256 constants that are in both files
+	sort(d_patterns.begin(), d_patterns.end(), [](const pattern &p1, const pattern &p2) {
+		if (p1.bin != p2.bin)
+			return p1.bin < p2.bin;
+		return p1.label < p2.label;
+	});
+	d_patterns.erase(unique(d_patterns.begin(), d_patterns.end(), [](const pattern &p1, const pattern &p2) {
+		return p1.bin == p2.bin && p1.label == p2.label;
+	}), d_patterns.end());
+
+	d_filter.assign((1U<<FILTER_BITS)/64, 0);
+	d_prefix.clear();
+
+	uint32_t pre = 0;
+	for (uint32_t i = 0; i < d_patterns.size(); ++i) {
+		memcpy(&pre, d_patterns[i].bin.data(), PREFIX_LEN);
+		uint32_t h = prefix_hash(pre);
+		d_filter[h/64] |= 1ULL<<(h % 64);
+		d_prefix.push_back(make_pair(pre, i));
+	}
+	sort(d_prefix.begin(), d_prefix.end());
+
+	return d_patterns.size() > 0 ? 0 : -1;
+}
+
+
+// report patterns that start in [start, end), reading at most up to size
+void scanner::scan_chunk(const unsigned char *blob, size_t size, size_t start, size_t end, vector<scan_hit> &hits) const
+{
+	if (size < PREFIX_LEN)
+		return;
+
+	uint32_t pre = 0;
+	scan_hit hit;
+
+	end = min(end, size - PREFIX_LEN + 1);
+	for (size_t off = start; off < end; ++off) {
+		memcpy(&pre, blob + off, PREFIX_LEN);
+		uint32_t h = prefix_hash(pre);
+		if (!(d_filter[h/64] & (1ULL<<(h % 64))))
+			continue;
+
+		auto it = lower_bound(d_prefix.begin(), d_prefix.end(), make_pair(pre, uint32_t(0)));
+		for (; it != d_prefix.end() && it->first == pre; ++it) {
+			const string &bin = d_patterns[it->second].bin;
+			if (bin.size() > size - off || memcmp(blob + off, bin.data(), bin.size()) != 0)
+				continue;
+			hit.offset = off;
+			hit.pattern = it->second;
+			hits.push_back(hit);
+		}
+	}
+}
+
+
+int scanner::scan(const string &path, unsigned int threads, vector<scan_hit> &hits) const
+{
+	hits.clear();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	size_t size = st.st_size;
+	if (size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	void *vp = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (vp == MAP_FAILED)
+		return -1;
+	madvise(vp, size, MADV_SEQUENTIAL);
+
+	const unsigned char *blob = reinterpret_cast<const unsigned char *>(vp);
+
+	// chunks overlap implicitly, as each thread may read past its end
+	// to complete a match that starts inside its chunk
+	if (threads == 0)
+		threads = 1;
+	size_t chunk = (size + threads - 1)/threads;
+	if (chunk < (1<<20))
+		chunk = 1<<20;
+
+	vector<vector<scan_hit>> part;
+	vector<thread> workers;
+	for (size_t start = 0; start < size; start += chunk)
+		part.push_back(vector<scan_hit>());
+
+	try {
+		for (size_t i = 1; i < part.size(); ++i)
+			workers.push_back(thread(&scanner::scan_chunk, this, blob, size, i*chunk, (i + 1)*chunk, ref(part[i])));
+	} catch (...) {
+		// scan what is left ourself
+		for (size_t i = workers.size() + 1; i < part.size(); ++i)
+			scan_chunk(blob, size, i*chunk, (i + 1)*chunk, part[i]);
+	}
+	scan_chunk(blob, size, 0, chunk, part[0]);
+
+	for (auto i = workers.begin(); i != workers.end(); ++i)
+		i->join();
+
+	munmap(vp, size);
+
+	for (auto i = part.begin(); i != part.end(); ++i)
+		hits.insert(hits.end(), i->begin(), i->end());
+
+	return 0;
+}
+
+
+string scanner::label(const scan_hit &h) const
+{
+	if (h.pattern >= d_patterns.size())
+		return "";
+	const pattern &p = d_patterns[h.pattern];
+	return p.label + (p.le ? " (le)" : " (be)");
+}
+
+
+}
+
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_scan_h
+#define number_scan_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "context.h"
+
+
+namespace number {
+
+
+struct scan_hit {
+	size_t offset{0};
+	uint32_t pattern{0};
+};
+
+
+// Finds known numbers (match DB and catalog) embedded in binary blobs,
+// in big and little endian byte order. A bitmap over the hashed first 4
+// bytes of every pattern rejects almost all offsets with a single lookup;
+// the file is mmap()ed and scanned in chunks by several threads.
+class scanner {
+
+	struct pattern {
+		std::string bin{""};
+		std::string label{""};
+		bool le{0};
+	};
+
+	enum {
+		PREFIX_LEN	= 4,
+		FILTER_BITS	= 24
+	};
+
+	std::vector<pattern> d_patterns;
+
+	// prefix -> pattern, sorted by prefix
+	std::vector<std::pair<uint32_t, uint32_t>> d_prefix;
+
+	std::vector<uint64_t> d_filter;
+
+	void add(const std::string &, const std::string &);
+
+	void scan_chunk(const unsigned char *, size_t, size_t, size_t, std::vector<scan_hit> &) const;
+
+public:
+
+	// patterns from the contexts catalog, including the match DB; call init_tables() first
+	int build(const context &);
+
+	int scan(const std::string &, unsigned int threads, std::vector<scan_hit> &) const;
+
+	std::string label(const scan_hit &) const;
+
+	size_t size()
+	{
+		return d_patterns.size();
+	}
+};
+
+
+}
+
+#endif
+
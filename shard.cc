@@ -0,0 +1,192 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <cstdint>
+#include <cinttypes>
+#include <string>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "misc.h"
+#include "shard.h"
+
+
+using namespace std;
+
+
+namespace number {
+
+
+// first line start at or after off
+static int line_start(FILE *f, uint64_t off, uint64_t size, uint64_t &start)
+{
+	if (off == 0 || off >= size) {
+		start = off < size ? off : size;
+		return 0;
+	}
+
+	// off is a line start if the byte before it ends a line
+	if (fseeko(f, off - 1, SEEK_SET) < 0)
+		return -1;
+	int c = 0;
+	start = off - 1;
+	while ((c = fgetc(f)) != EOF) {
+		++start;
+		if (c == '\n')
+			return 0;
+	}
+	start = size;
+	return 0;
+}
+
+
+int shard_range(const string &path, unsigned int k, unsigned int n, shard_state &st)
+{
+	if (n == 0 || k >= n)
+		return -1;
+
+	free_ptr<FILE> f(fopen(path.c_str(), "r"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	struct stat stb;
+	if (fstat(fileno(f.get()), &stb) < 0 || !S_ISREG(stb.st_mode))
+		return -1;
+	uint64_t size = stb.st_size;
+
+	// neighbouring shards compute their common border the same way
+	if (line_start(f.get(), size/n*k + size%n*k/n, size, st.start) < 0 ||
+	    line_start(f.get(), size/n*(k + 1) + size%n*(k + 1)/n, size, st.end) < 0)
+		return -1;
+
+	st.k = k;
+	st.n = n;
+	st.in_off = st.start;
+	st.out_off = 0;
+	st.records = st.invalid = 0;
+	st.done = 0;
+	return 0;
+}
+
+
+string shard_path(const string &base, unsigned int k, const char *suffix)
+{
+	return base + "." + to_string(k) + suffix;
+}
+
+
+int shard_load(const string &path, shard_state &st)
+{
+	free_ptr<FILE> f(fopen(path.c_str(), "r"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	char buf[256];
+	unsigned int done = 0;
+	while (fgets(buf, sizeof(buf), f.get())) {
+		if (buf[0] == '#')
+			continue;
+		if (sscanf(buf, "%u %u %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %u",
+		           &st.k, &st.n, &st.start, &st.end, &st.in_off, &st.out_off, &st.records, &st.invalid, &done) != 9)
+			return -1;
+		st.done = (done != 0);
+		return 0;
+	}
+	return -1;
+}
+
+
+int shard_save(const string &path, const shard_state &st)
+{
+	string tmp = path + ".tmp";
+	free_ptr<FILE> f(fopen(tmp.c_str(), "w"), number::fclose);
+	if (!f.get())
+		return -1;
+
+	fprintf(f.get(), "# number shard checkpoint v1: k n start end in_off out_off records invalid done\n");
+	fprintf(f.get(), "%u %u %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %u\n",
+	        st.k, st.n, st.start, st.end, st.in_off, st.out_off, st.records, st.invalid, st.done ? 1 : 0);
+
+	if (fflush(f.get()) != 0 || fsync(fileno(f.get())) < 0)
+		return -1;
+	f.reset();
+
+	if (rename(tmp.c_str(), path.c_str()) < 0)
+		return -1;
+	return 0;
+}
+
+
+int shard_claim(const string &path)
+{
+	int fd = open(path.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+	if (flock(fd, LOCK_EX|LOCK_NB) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+int shard_merge(const string &base, unsigned int n, FILE *out, shard_state &total)
+{
+	shard_state st;
+	char buf[1<<16];
+
+	total = shard_state();
+	total.n = n;
+
+	for (unsigned int k = 0; k < n; ++k) {
+		if (shard_load(shard_path(base, k, ".ckpt"), st) < 0 || !st.done || st.k != k || st.n != n)
+			return -1;
+
+		free_ptr<FILE> f(fopen(shard_path(base, k).c_str(), "r"), number::fclose);
+		if (!f.get())
+			return -1;
+
+		// anything past out_off was not covered by the checkpoint
+		uint64_t left = st.out_off;
+		size_t r = 0;
+		while (left > 0 && (r = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), f.get())) > 0) {
+			if (fwrite(buf, 1, r, out) != r)
+				return -1;
+			left -= r;
+		}
+		if (left > 0)
+			return -1;
+
+		total.records += st.records;
+		total.invalid += st.invalid;
+	}
+
+	total.done = 1;
+	return 0;
+}
+
+
+}
+
@@ -0,0 +1,68 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_shard_h
+#define number_shard_h
+
+#include <cstdio>
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+
+
+namespace number {
+
+
+// Position and partial stats of one shard of a batch run. A shard owns
+// the lines whose first byte lies in [start, end) of the input file.
+struct shard_state {
+	unsigned int k{0}, n{1};
+	uint64_t start{0}, end{UINT64_MAX};
+	uint64_t in_off{0}, out_off{0};
+	uint64_t records{0}, invalid{0};
+	bool done{0};
+};
+
+
+// byte range of shard k of n of the file, aligned to line starts
+int shard_range(const std::string &path, unsigned int k, unsigned int n, shard_state &);
+
+// "base.k" for the output, "base.k.ckpt" for the checkpoint, "base.k.lock" for the claim
+std::string shard_path(const std::string &base, unsigned int k, const char *suffix = "");
+
+// one line checkpoint, written to a temporary file and renamed
+int shard_load(const std::string &path, shard_state &);
+
+int shard_save(const std::string &path, const shard_state &);
+
+// Claim a shard by an exclusive flock() on its lock file, so that processes
+// on hosts sharing the filesystem pick different shards. Returns the fd that
+// holds the claim until closed (or the process dies), -1 if taken or on error.
+int shard_claim(const std::string &path);
+
+// Copy the outputs of all n finished shards in order to out and sum up
+// their stats in total. Returns -1 if a shard is missing or unfinished.
+int shard_merge(const std::string &base, unsigned int n, FILE *out, shard_state &total);
+
+}
+
+#endif
+
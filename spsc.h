@@ -0,0 +1,101 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_spsc_h
+#define number_spsc_h
+
+#include <cstdint>
+#include <sys/types.h>
+#include <atomic>
+#include <vector>
+#include <utility>
+
+
+namespace number {
+
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// Head and tail are a cache line apart, so that the two sides only
+// share a line when they actually hand over slots.
+template<typename T>
+class spsc_ring {
+
+	std::vector<T> d_slots;
+
+	size_t d_mask{0};
+
+	std::atomic<size_t> d_head{0};	// next slot to pop, written by the consumer
+
+	// alignas() would need C++17 aligned new for heap allocated rings
+	char d_pad[64];
+
+	std::atomic<size_t> d_tail{0};	// next slot to push, written by the producer
+
+public:
+
+	// capacity is rounded up to a power of two
+	explicit spsc_ring(size_t capacity)
+	{
+		size_t n = 2;
+		while (n < capacity)
+			n <<= 1;
+		d_slots.resize(n);
+		d_mask = n - 1;
+	}
+
+	spsc_ring(const spsc_ring &) = delete;
+
+	spsc_ring &operator=(const spsc_ring &) = delete;
+
+	// producer side; false if full, v is left untouched then
+	bool push(T &v)
+	{
+		size_t t = d_tail.load(std::memory_order_relaxed);
+		if (t - d_head.load(std::memory_order_acquire) > d_mask)
+			return false;
+		std::swap(d_slots[t & d_mask], v);
+		d_tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side; false if empty. Slots are swapped rather than moved,
+	// so that buffers travel back and forth instead of being reallocated.
+	bool pop(T &v)
+	{
+		size_t h = d_head.load(std::memory_order_relaxed);
+		if (h == d_tail.load(std::memory_order_acquire))
+			return false;
+		std::swap(v, d_slots[h & d_mask]);
+		d_head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const
+	{
+		return d_head.load(std::memory_order_acquire) == d_tail.load(std::memory_order_acquire);
+	}
+};
+
+
+}
+
+#endif
+
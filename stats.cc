@@ -0,0 +1,280 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "stats.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#include <nmmintrin.h>
+#define NUMBER_HAVE_SSE_STATS 1
+#endif
+
+
+namespace number {
+
+using namespace std;
+
+
+namespace {
+
+// what the per-byte pass collects; seen lists the byte values that occur,
+// so that only those have to be visited afterwards
+struct pass_state {
+	uint32_t hist[256];
+	unsigned char seen[256];
+	unsigned int distinct{0};
+	uint64_t weight{0};
+	size_t printable{0}, run{0}, cur{0};
+	int prev{-1};
+};
+
+}
+
+
+static inline bool is_printable(unsigned char c)
+{
+	return (c >= 0x20 && c < 0x7f) || c == '\t' || c == '\n' || c == '\r';
+}
+
+
+// histogram and runs of p[0..n)
+static inline void pass_bytes(const unsigned char *p, size_t n, pass_state &ps)
+{
+	for (size_t i = 0; i < n; ++i) {
+		if (ps.hist[p[i]]++ == 0)
+			ps.seen[ps.distinct++] = p[i];
+		ps.cur = (p[i] == ps.prev) ? ps.cur + 1 : 1;
+		if (ps.cur > ps.run)
+			ps.run = ps.cur;
+		ps.prev = p[i];
+	}
+}
+
+
+static void pass_portable(const unsigned char *p, size_t n, pass_state &ps)
+{
+	uint64_t w = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		memcpy(&w, p + i, 8);
+		ps.weight += __builtin_popcountll(w);
+	}
+	for (; i < n; ++i)
+		ps.weight += __builtin_popcount(p[i]);
+	for (i = 0; i < n; ++i)
+		ps.printable += is_printable(p[i]);
+
+	pass_bytes(p, n, ps);
+}
+
+
+#ifdef NUMBER_HAVE_SSE_STATS
+
+// popcount and printable test 16 bytes at a time, histogram and runs alongside
+__attribute__((target("popcnt,sse2")))
+static void pass_sse(const unsigned char *p, size_t n, pass_state &ps)
+{
+	const __m128i lo = _mm_set1_epi8(0x1f), hi = _mm_set1_epi8(0x7f);
+	const __m128i tab = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+
+		ps.weight += _mm_popcnt_u64(_mm_cvtsi128_si64(v)) + _mm_popcnt_u64(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v)));
+
+		// signed compare: 0x80..0xff are negative and thus not above 0x1f
+		__m128i pr = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		pr = _mm_or_si128(pr, _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr))));
+		ps.printable += _mm_popcnt_u32(_mm_movemask_epi8(pr));
+
+		pass_bytes(p + i, 16, ps);
+	}
+
+	pass_portable(p + i, n - i, ps);
+}
+
+#endif
+
+
+typedef void (*pass_t)(const unsigned char *, size_t, pass_state &);
+
+
+static pass_t select_pass()
+{
+#ifdef NUMBER_HAVE_SSE_STATS
+	if (__builtin_cpu_supports("popcnt"))
+		return pass_sse;
+#endif
+	return pass_portable;
+}
+
+
+static const pass_t pass = select_pass();
+
+
+// k*log2(k) for the byte counts of numbers up to 2048 bits
+static const struct klogk_table {
+	double v[256];
+
+	klogk_table()
+	{
+		v[0] = 0;
+		for (unsigned int k = 1; k < 256; ++k)
+			v[k] = k*log2(double(k));
+	}
+} klogk;
+
+
+// Number of the n words of size SZ at p that equal an earlier one, via
+// a hash set in tab with the next power of two >= 2n (at least 2) slots.
+template<size_t SZ>
+static unsigned int repeats(const unsigned char *p, size_t n, uint64_t *tab)
+{
+	unsigned int bits = 1;
+	while ((size_t(1) << bits) < 2*n)
+		++bits;
+	memset(tab, 0, sizeof(uint64_t) << bits);
+
+	unsigned int r = 0, zeros = 0;
+	uint64_t mask = (uint64_t(1) << bits) - 1;
+
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t w = 0;
+		memcpy(&w, p + i*SZ, SZ);
+
+		// 0 marks empty slots
+		if (w == 0) {
+			r += (zeros++ > 0);
+			continue;
+		}
+		for (uint64_t h = (w*0x9e3779b97f4a7c15ULL) >> (64 - bits);; h = (h + 1) & mask) {
+			if (tab[h] == w) {
+				++r;
+				break;
+			}
+			if (tab[h] == 0) {
+				tab[h] = w;
+				break;
+			}
+		}
+	}
+	return r;
+}
+
+
+// sizes of keys, hashes and field elements a number may claim to have
+static const unsigned int key_sizes[] = {
+	64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 521, 571,
+	768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 15360, 16384
+};
+
+
+void byte_stats::scan(const unsigned char *p, size_t n, uint64_t *words)
+{
+	*this = byte_stats();
+	bytes = n;
+	if (n == 0)
+		return;
+
+	pass_state ps;
+	memset(ps.hist, 0, sizeof(ps.hist));
+	pass(p, n, ps);
+
+	weight = ps.weight;
+	printable = ps.printable;
+	run = ps.run;
+	bits = 8*n - (p[0] ? __builtin_clz(p[0]) - 24 : 8);
+
+	// H = log2(n) - sum(k*log2(k))/n over the byte counts k
+	double sum = 0;
+	distinct = ps.distinct;
+	for (unsigned int i = 0; i < distinct; ++i) {
+		uint32_t k = ps.hist[ps.seen[i]];
+		sum += k < 256 ? klogk.v[k] : k*log2(double(k));
+	}
+	entropy = log2(double(n)) - sum/n;
+	if (entropy < 0)
+		entropy = 0;
+
+	// words aligned to the least significant end, as leading zeros are gone
+	rep32 = repeats<4>(p + n % 4, n/4, words);
+	rep64 = repeats<8>(p + n % 8, n/8, words);
+
+	for (size_t i = 0; i < sizeof(key_sizes)/sizeof(key_sizes[0]); ++i) {
+		if (key_sizes[i] >= bits) {
+			top = key_sizes[i] - bits;
+			break;
+		}
+	}
+
+	// below 64 bits about anything could be chance
+	if (bits < 64)
+		return;
+
+	scored = 1;
+	unsigned int penalty = 0;
+
+	// more than 4 standard deviations off bits/2
+	double z = fabs(double(weight) - bits/2.0)/(sqrt(double(bits))/2.0);
+	if (z > 4) {
+		flags |= FLAG_WEIGHT;
+		penalty += min(30.0, 5*(z - 3));
+	}
+
+	// random bytes get close to the maximum of log2(min(n, 256))
+	if (n >= 32 && entropy < 0.8*log2(double(min(n, size_t(256))))) {
+		flags |= FLAG_ENTROPY;
+		penalty += 20;
+	}
+
+	// a random run of 4 equal bytes has probability about n/2^24
+	if (run >= 4) {
+		flags |= FLAG_RUNS;
+		penalty += min(size_t(30), 10*(run - 3));
+	}
+
+	if (n >= 12 && printable*10 >= n*9) {
+		flags |= FLAG_ASCII;
+		penalty += 30;
+	}
+
+	if (rep64 > 0 || rep32 > 0) {
+		flags |= FLAG_REPEAT;
+		penalty += rep64 > 0 ? 30 : 20;
+	}
+
+	if (top >= 16) {
+		flags |= FLAG_TOP;
+		penalty += 15;
+	}
+
+	score = penalty >= 100 ? 0 : 100 - penalty;
+}
+
+
+}
+
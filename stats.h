@@ -0,0 +1,66 @@
+/*
+ * This file is part of the number framework.
+ *
+ * (C) 2018 by Sebastian Krahmer,
+ *             sebastian [dot] krahmer [at] gmail [dot] com
+ *
+ * number is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * number is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with number.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef number_stats_h
+#define number_stats_h
+
+#include <cstdint>
+#include <sys/types.h>
+
+
+namespace number {
+
+
+// Structure of the big-endian bytes of a number, for spotting output of
+// broken RNGs. Tests that need more data than there is are skipped.
+struct byte_stats {
+
+	enum flag_t {
+		FLAG_WEIGHT	= 1,	// Hamming weight far off half the bits
+		FLAG_ENTROPY	= 2,	// few distinct byte values
+		FLAG_RUNS	= 4,	// long run of one byte value
+		FLAG_ASCII	= 8,	// (nearly) all printable
+		FLAG_REPEAT	= 16,	// 32 or 64bit word occurs twice
+		FLAG_TOP	= 32	// many bits short of the next usual key size
+	};
+
+	size_t bytes{0}, bits{0};
+	uint64_t weight{0};		// set bits
+	unsigned int distinct{0};	// byte values that occur
+	double entropy{0};		// Shannon entropy in bits per byte
+	size_t run{0};			// longest run of one byte value
+	size_t printable{0};
+	unsigned int rep32{0}, rep64{0};	// aligned words equal to an earlier one
+	unsigned int top{0};		// bits short of the next usual key size
+
+	unsigned int score{100};	// 100 for nothing suspicious, down to 0
+	uint32_t flags{0};
+	bool scored{0};			// score and flags are only set from 64 bits on
+
+	// words is scratch space for bytes + 2 entries
+	void scan(const unsigned char *, size_t, uint64_t *words);
+};
+
+
+}
+
+#endif
+